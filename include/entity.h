@@ -0,0 +1,61 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include "level.h"
+#include <stdint.h>
+
+/*
+ * Entities
+ *
+ * Enemies and other moving objects live in an EntityStore. Each component
+ * has its own array, rather than one array of structs like Player. An
+ * update runs a few kernels over whole arrays: integrate and hop have no
+ * calls and only selects for branches, so the compiler vectorizes them.
+ * Collide works one entity at a time, since it looks up tiles. Boxes match
+ * the player's: x is the centre and y the top.
+ */
+
+typedef enum {
+  ENTITY_WALKER, // Walks, turning at walls and ledges
+  ENTITY_JUMPER, // Walks, turning at walls, and hops at intervals
+  ENTITY_TYPE_COUNT
+} EntityType;
+
+#define ENTITY_FLAG_ON_GROUND 0x01
+#define ENTITY_FLAG_HOPS 0x02 // Set for jumpers, so hop() tests one byte
+
+typedef struct {
+  float *x;
+  float *y;
+  float *vel_x;
+  float *vel_y;
+  float *timer;   // Seconds until the next hop
+  uint8_t *flags; // ENTITY_FLAG_* bits
+  uint8_t *type;  // EntityType
+  int count;
+  int capacity;
+} EntityStore;
+
+// Start an empty store
+void entity_store_init(EntityStore *store);
+
+// Free the component arrays
+void entity_store_free(EntityStore *store);
+
+// Add an entity standing at (x, y), moving right. Returns its index, or -1
+// if out of memory. Indices change when entities are removed.
+int entity_spawn(EntityStore *store, EntityType type, float x, float y);
+
+// Remove an entity; the last one takes its index
+void entity_remove(EntityStore *store, int index);
+
+// Advance every entity by dt seconds against the level's tiles. Entities
+// that fall out of the bottom of the level are removed; ones over streamed
+// chunks not loaded yet hold still.
+void entity_update(EntityStore *store, Level *level, float dt);
+
+// Entities over loaded tiles, i.e. the ones entity_update() moves rather
+// than holding for their chunk to load
+int entity_count_active(const EntityStore *store, const Level *level);
+
+#endif
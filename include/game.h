@@ -1,17 +1,39 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include "entity.h"
+#include "input.h"
 #include "level.h"
 #include "player.h"
+#include "present.h"
 #include "render.h"
 #include "terminal.h"
 #include <stdbool.h>
 
+// Default fixed simulation tick; Game.tick can lower the rate, e.g. for
+// headless runs, since collisions are swept rather than sampled
+#define GAME_TICK_RATE 60
+#define GAME_TICK (1.0f / GAME_TICK_RATE)
+
+// Loaded chunks a streamed level may keep beyond the ones around the view
+#define GAME_STREAM_BUDGET (4 << 20)
+
+// Seconds of travel at the player's speed to load ahead of the view
+#define GAME_STREAM_LEAD 1.5f
+
+// How often the loop needs to wake up
+typedef enum {
+  GAME_ACTIVE,  // Something moves: tick at the full frame rate
+  GAME_RESTING, // Player standing still: tick at a low rate
+  GAME_IDLE     // Paused or won and at rest: no ticks, wait for input
+} GamePace;
+
 typedef struct {
   Terminal terminal;
   ScreenBuffer *screen;
   Player player;
   Level level;
+  EntityStore entities; // Enemies, cleared when the level changes
   bool running;
   double last_time;
   float camera_x;
@@ -20,17 +42,61 @@ typedef struct {
   float spawn_y;
   bool paused;
   bool victory;
+  long frames_rendered; // Frames handed to the terminal
+  long frames_dropped;  // Frames skipped because the terminal was behind
+  Presenter *presenter; // Output thread, NULL to render synchronously
+  float tick;           // Seconds simulated by each game_step()
+  double accumulator;   // Real time not yet simulated, less than a tick
+  float prev_x;         // Player and camera positions before the last tick;
+  float prev_y;         // rendering interpolates from these to the current
+  float prev_camera_x;  // positions by render_alpha
+  float prev_camera_y;
+  float render_alpha;
+  bool show_profile; // Frame timing overlay on the HUD
+  InputParser input;
+  bool key_releases; // Terminal reports key releases (kitty protocol)
+  bool held_left;    // Movement keys down; only tracked with key_releases
+  bool held_right;
+  GamePace pace;       // Pace chosen after the last frame
+  long frames_resting; // Frames run at the resting tick rate
+  long idle_waits;     // Times the loop slept until input
+  size_t checkpoint;   // Level edit mark a death rolls back to
 } Game;
 
 // Initialize game
 int game_init(Game *game);
 
+// Initialize game without a tty: frames go to the given backend (path is
+// used by TERM_BACKEND_FILE) and input comes from term_set_input_script()
+int game_init_headless(Game *game, TermBackend backend, const char *path,
+                       int width, int height);
+
+// Replace the current level with a level file and restart at its spawn
+// point. Binary levels are streamed from disk as the camera moves. On
+// failure the current level is kept and -1 is returned.
+int game_load_level(Game *game, const char *path);
+
+// Replace the current level with one already built, e.g. by
+// level_generate(), taking over its storage, and restart at its spawn point
+void game_set_level(Game *game, Level *level);
+
+// Start the current level over: undo every change to it (collected coins)
+// and reset the player, in time proportional to the changes made
+void game_restart(Game *game);
+
 // Cleanup game resources
 void game_cleanup(Game *game);
 
 // Main game loop
 void game_run(Game *game);
 
+// Run up to max_frames frames, one tick each, without throttling.
+// Returns the number of frames run.
+int game_run_headless(Game *game, int max_frames);
+
+// Advance the simulation by one fixed tick (game->tick seconds)
+void game_step(Game *game);
+
 // Update game state
 void game_update(Game *game, float delta_time);
 
@@ -40,4 +106,7 @@ void game_render(Game *game);
 // Handle input
 void game_handle_input(Game *game);
 
+// Classify the current state for pacing the main loop
+GamePace game_pace(const Game *game);
+
 #endif
@@ -0,0 +1,82 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Keyboard input
+ *
+ * Bytes are read from the terminal in bulk into a ring buffer and decoded
+ * by an incremental VT state machine, so escape sequences split across
+ * reads still parse. Plain keys, legacy CSI/SS3 cursor keys and kitty
+ * keyboard protocol CSI u sequences all become KeyEvents. Only the kitty
+ * protocol reports repeats and releases; legacy terminals send presses.
+ */
+
+#define INPUT_RING_SIZE 256 // Power of two
+#define INPUT_MAX_PARAMS 4
+#define INPUT_MAX_SUBPARAMS 3
+
+// A lone ESC is the Escape key once nothing follows it for this long
+#define INPUT_ESC_TIMEOUT_NS 50000000ULL
+
+// Keys without a character sit above the Unicode range; other keys use
+// their code point (kitty reports letters unshifted, e.g. 'a' with shift)
+typedef enum {
+  KEY_NONE = 0,
+  KEY_ENTER = 13,
+  KEY_ESCAPE = 27,
+  KEY_UP = 0x110000,
+  KEY_DOWN,
+  KEY_RIGHT,
+  KEY_LEFT,
+  KEY_HOME,
+  KEY_END
+} InputKey;
+
+typedef enum { KEY_PRESS, KEY_REPEAT, KEY_RELEASE } KeyAction;
+
+// Modifier bits, as encoded by xterm and the kitty protocol minus one
+#define KEY_MOD_SHIFT 1
+#define KEY_MOD_ALT 2
+#define KEY_MOD_CTRL 4
+
+typedef struct {
+  int key;
+  KeyAction action;
+  int mods;
+} KeyEvent;
+
+typedef struct {
+  unsigned char ring[INPUT_RING_SIZE];
+  unsigned head; // Next byte to parse (free-running)
+  unsigned tail; // Next byte to fill (free-running)
+
+  int state;           // Position in the escape sequence being parsed
+  bool private_seq;    // CSI with a ? > < = marker: a terminal reply
+  bool intermediate;   // CSI with intermediate bytes, e.g. DECRQM replies
+  int params[INPUT_MAX_PARAMS][INPUT_MAX_SUBPARAMS];
+  int param;           // Index of the parameter being read
+  int sub;             // Index of its ':' sub-parameter
+  uint64_t esc_ns;     // When the pending ESC arrived
+  bool frame_complete; // Last read ended a scripted frame's input
+} InputParser;
+
+void input_init(InputParser *p);
+
+// Read queued terminal input into the ring. Returns true when the ring
+// filled up and more input may still be waiting.
+bool input_read(InputParser *p);
+
+// Append raw bytes as if read from the terminal; returns the count taken
+int input_feed(InputParser *p, const char *data, int len);
+
+// Decode the next key event; false when more bytes are needed
+bool input_next(InputParser *p, KeyEvent *ev);
+
+// True while a partial sequence is buffered. Callers keep calling
+// input_next() so a lone ESC can time out into KEY_ESCAPE.
+bool input_waiting(const InputParser *p);
+
+#endif
@@ -2,29 +2,203 @@
 #define LEVEL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
+// Size of the built-in level
 #define LEVEL_WIDTH 200
 #define LEVEL_HEIGHT 50
 
-typedef enum {
-  TILE_EMPTY = ' ',
-  TILE_GROUND = '#',
-  TILE_BRICK = '=',
-  TILE_COIN = 'o',
-  TILE_SPIKE = '^',
-  TILE_GOAL = 'F',     // Flag
-  TILE_PLATFORM = '-', // One-way platform (can jump through from below)
-  TILE_QUESTION = '?', // Question block (can be hit from below for coin)
-  TILE_PIPE_LEFT = '[',
-  TILE_PIPE_RIGHT = ']'
-} TileType;
+// Largest level accepted from a file, in each dimension, and the most tile
+// chunks it may span (bounds the chunk directory at 32 MB)
+#define LEVEL_MAX_SIZE (1 << 24)
+#define LEVEL_MAX_CHUNKS (1 << 22)
 
+#define LEVEL_NAME_MAX 64
+
+// Binary level files: magic and format version (see level_encode())
+#define LEVEL_BIN_MAGIC "TLVB"
+#define LEVEL_BIN_VERSION 1
+
+// Tiles are stored, and binary files encoded, in square chunks
+#define LEVEL_CHUNK_SHIFT 5
+#define LEVEL_CHUNK_SIZE (1 << LEVEL_CHUNK_SHIFT)
+
+// Tile properties; tiles outside the level have none
+#define TILE_FLAG_SOLID 0x01       // Blocks movement from every side
+#define TILE_FLAG_ONE_WAY 0x02     // Can be landed on from above only
+#define TILE_FLAG_DEADLY 0x04      // Kills the player on touch
+#define TILE_FLAG_COLLECTIBLE 0x08 // Picked up on touch
+#define TILE_FLAG_GOAL 0x10        // Completes the level on touch
+
+// Every tile: TileType name, character in level files and in tile storage,
+// and property flags. TileType and level_tile_flags are generated from this
+// list, so a new tile is one line here plus its colors in game.c.
+#define LEVEL_TILES(X)                                                         \
+  X(TILE_EMPTY, ' ', 0)                                                        \
+  X(TILE_GROUND, '#', TILE_FLAG_SOLID)                                         \
+  X(TILE_BRICK, '=', TILE_FLAG_SOLID)                                          \
+  X(TILE_COIN, 'o', TILE_FLAG_COLLECTIBLE)                                     \
+  X(TILE_SPIKE, '^', TILE_FLAG_DEADLY)                                         \
+  X(TILE_GOAL, 'F', TILE_FLAG_GOAL) /* Flag */                                 \
+  X(TILE_PLATFORM, '-', TILE_FLAG_ONE_WAY) /* Jump through from below */       \
+  X(TILE_QUESTION, '?', TILE_FLAG_SOLID) /* Can be hit from below */           \
+  X(TILE_PIPE_LEFT, '[', TILE_FLAG_SOLID)                                      \
+  X(TILE_PIPE_RIGHT, ']', TILE_FLAG_SOLID)
+
+#define LEVEL_TILE_ENUM(name, ch, flags) name = ch,
+typedef enum { LEVEL_TILES(LEVEL_TILE_ENUM) } TileType;
+#undef LEVEL_TILE_ENUM
+
+// Property flags of each tile byte; bytes that are not tiles have none
+extern const unsigned char level_tile_flags[256];
+
+// Flags over a rectangle of tiles: any has the flags of at least one tile,
+// all those shared by every tile
+typedef struct {
+  unsigned any;
+  unsigned all;
+} TileQuery;
+
+// The flags below 1 << LEVEL_LAYERS (solid, one-way, deadly, collectible)
+// are also kept as collision layers: bitsets with one 32-bit word per
+// chunk row, so whole spans can be tested a word at a time
+#define LEVEL_LAYERS 4
+
+typedef struct {
+  unsigned char tiles[LEVEL_CHUNK_SIZE][LEVEL_CHUNK_SIZE];
+  uint32_t layers[LEVEL_LAYERS][LEVEL_CHUNK_SIZE]; // Bit x of row y per flag
+} LevelChunk;
+
+// Collectibles left in one chunk: the per-region summary of the index
 typedef struct {
-  TileType tiles[LEVEL_HEIGHT][LEVEL_WIDTH];
+  uint16_t coins;
+  uint16_t questions;
+} LevelChunkItems;
+
+// Level-wide collectible counts, kept current as tiles change, so the HUD
+// and end-of-level stats never scan tiles
+typedef struct {
+  long coins_total;     // Coins at load, plus any placed since
+  long coins_left;      // Coins still in the level
+  long coins_collected; // Taken with level_collect_coin()
+  long questions;       // Question blocks in the level
+} LevelItems;
+
+// One journaled level_set_tile(): where, and the tile it replaced
+typedef struct {
+  int32_t x;
+  int32_t y;
+  unsigned char tile;
+  bool collected; // Made by level_collect_coin()
+} LevelEdit;
+
+// Loader state of a level opened with level_stream_open()
+typedef struct LevelStream LevelStream;
+
+// Tiles are stored one byte each (the TileType character) in chunks found
+// through a row-major directory, so a lookup is two indexings and rows
+// within a chunk are plain byte spans. Chunks that are all empty or all
+// ground point at shared read-only chunks and get private storage on their
+// first write, so memory follows the level's content, not its area.
+typedef struct {
+  int width;
+  int height;
+  int chunks_x;        // Directory size in chunks, edge chunks included
+  int chunks_y;
+  LevelChunk **chunks; // chunks_x * chunks_y entries, row-major
+  long chunks_owned;   // Private chunks allocated for this level
+  LevelStream *stream; // Set while chunks load from disk, else NULL
+  LevelChunkItems *chunk_items; // Per chunk, same layout as chunks
+  LevelItems items;
+  LevelEdit *edits; // Changes since the level was built, oldest first
+  size_t edit_count;
+  size_t edit_capacity;
+  int spawn_x;
+  int spawn_y;
+  int number;                // LEVEL header, 0 if absent
+  char name[LEVEL_NAME_MAX]; // NAME header, empty if absent
 } Level;
 
-// Initialize a test level
-void level_init(Level *level);
+// Build the built-in level. Returns 0 on success, -1 if out of memory.
+int level_init(Level *level);
+
+// Create an empty width x height level with the default spawn point, for
+// filling with level_set_tile_raw(). Returns -1 if the size is out of range
+// or out of memory.
+int level_create(Level *level, int width, int height);
+
+// Point chunks that became all empty or all ground back at the shared
+// copies, e.g. after filling a level with level_set_tile_raw()
+void level_compact(Level *level);
+
+// Load a level file, text or binary (detected by LEVEL_BIN_MAGIC), as
+// described in LEVEL_FORMAT.md. Prints the reason to stderr and returns -1
+// on failure, leaving level untouched.
+int level_load(Level *level, const char *path);
+
+// Parse a text level held in memory; name is used in error messages
+int level_parse(Level *level, const char *data, size_t len, const char *name);
+
+// Decode a binary level held in memory; name is used in error messages
+int level_decode(Level *level, const unsigned char *data, size_t len,
+                 const char *name);
+
+// Encode a level in the binary format into a malloc'd buffer
+int level_encode(Level *level, unsigned char **out, size_t *out_len);
+
+// Write a level to path in the binary format
+int level_save(Level *level, const char *path);
+
+// Free the level's tile storage, stopping its loader if it streams
+void level_free(Level *level);
+
+/*
+ * Streaming
+ *
+ * A streamed binary level starts with only its header, chunk directory and
+ * the chunks around the spawn point in memory. A loader thread reads other
+ * chunks with pread() as level_stream_update() asks for them, and the next
+ * update installs them, so the caller never waits on the disk. Chunks not
+ * loaded yet read as empty. Chunks written with level_set_tile() stay
+ * resident; the rest are evicted least recently wanted first. Collectibles
+ * are counted as each chunk first loads, so level->items grows with the
+ * part of the level seen so far.
+ */
+
+typedef struct {
+  long loaded;     // Chunks read and installed
+  long evicted;    // Chunks dropped to stay within the budget
+  long errors;     // Chunks that could not be read; they stay empty
+  size_t resident; // Private chunks in memory
+} LevelStreamStats;
+
+// True if path starts with LEVEL_BIN_MAGIC
+bool level_file_is_binary(const char *path);
+
+// Open a binary level for streaming, keeping about budget bytes of loaded
+// chunks beyond the ones in use. Only the header and chunk table are
+// checked up front (not the whole-file checksum); each chunk is validated
+// as it loads. Prints the reason to stderr and returns -1 on failure.
+int level_stream_open(Level *level, const char *path, size_t budget);
+
+// Install chunks the loader finished, then request the chunks covering the
+// view (x, y, width, height in tiles) plus a chunk of margin, extended by
+// lead tiles to the right (or left if negative), nearest the view first.
+// Evicts chunks over the budget that none of these cover. Does nothing for
+// a level that is not streamed.
+void level_stream_update(Level *level, int x, int y, int width, int height,
+                         int lead);
+
+// Loader counters; all zero for a level that is not streamed
+void level_stream_get_stats(const Level *level, LevelStreamStats *stats);
+
+// False while the chunk holding (x, y) in a streamed level is not loaded
+// yet and reads as empty; true for every other tile
+bool level_tile_loaded(const Level *level, int x, int y);
+
+// Bytes of tile storage the level owns: its directory and private chunks
+size_t level_memory_usage(const Level *level);
 
 // Check if a tile is solid
 bool level_is_solid(Level *level, int x, int y);
@@ -41,10 +215,61 @@ bool level_is_goal(Level *level, int x, int y);
 // Check if a tile is a coin
 bool level_is_coin(Level *level, int x, int y);
 
-// Collect a coin at position
+// Collect a coin at position, counting it in level->items
 void level_collect_coin(Level *level, int x, int y);
 
+// Coins left from (x0, y0) to (x1, y1) inclusive. Chunks the rectangle
+// covers whole are read from their summaries, the rest from their
+// collectible layers. Streamed chunks not resident count nothing, whether
+// never loaded or evicted, so only coins level_get_tile() can see count.
+long level_count_coins(Level *level, int x0, int y0, int x1, int y1);
+
 // Get tile at position
 TileType level_get_tile(Level *level, int x, int y);
 
+// Combine the flags of the tiles from (x0, y0) to (x1, y1) inclusive in
+// one bounds-checked pass. Tiles outside the level count as empty; an
+// empty rectangle gives zero for both.
+TileQuery level_query_rect(Level *level, int x0, int y0, int x1, int y1);
+
+// Set the tile at a position, journaling the tile it replaces. Returns -1
+// if (x, y) is outside the level or out of memory.
+int level_set_tile(Level *level, int x, int y, TileType tile);
+
+// Set a tile as part of building the level, without journaling it. Only
+// for levels with an empty journal: a later rollback would not undo it.
+int level_set_tile_raw(Level *level, int x, int y, TileType tile);
+
+/*
+ * Edit journal
+ *
+ * The level as built or loaded is the base, and every change after it is
+ * journaled, so rolling back costs time in proportion to the changes made
+ * rather than the size of the level. Tile reads never consult the journal.
+ */
+
+// Mark the current state to roll back to later
+size_t level_checkpoint(const Level *level);
+
+// Undo every change made after mark, newest first, including coin
+// collections. level_rollback(level, 0) restores the base level.
+void level_rollback(Level *level, size_t mark);
+
+// Make the current tiles the new base and forget the journal
+void level_commit(Level *level);
+
+// First column from x0 to x1 inclusive on row y whose tile has any of the
+// given layer flags, or -1 if there is none. Scans the layer bitsets a
+// word at a time.
+int level_row_find_first(Level *level, unsigned flags, int y, int x0, int x1);
+
+// Last such column from x1 back to x0, or -1
+int level_row_find_last(Level *level, unsigned flags, int y, int x0, int x1);
+
+// Get the contiguous run of tiles on row y starting at column x, which ends
+// at the edge of the level or of its chunk. Stores the run length in count;
+// returns NULL if (x, y) is outside the level.
+const unsigned char *level_get_row_span(Level *level, int x, int y,
+                                        int *count);
+
 #endif
@@ -0,0 +1,35 @@
+#ifndef LEVELGEN_H
+#define LEVELGEN_H
+
+#include "level.h"
+#include <stdint.h>
+
+/*
+ * Procedural Levels
+ *
+ * Builds levels of any size from a seed, for tests and benchmarks. The
+ * level is split into tiers of LEVELGEN_TIER_HEIGHT rows, each with its
+ * own floor, and every tier into short sections. Each section may get one
+ * feature: a pit, a platform, a pipe, a spike field, a coin cluster or a
+ * row of question blocks. The same parameters always give the same level.
+ */
+
+#define LEVELGEN_TIER_HEIGHT 16
+#define LEVELGEN_MIN_WIDTH 32
+#define LEVELGEN_MIN_HEIGHT 8
+
+typedef struct {
+  int width;
+  int height;
+  uint64_t seed;
+  float density; // Chance, 0 to 1, that a section gets a feature
+} LevelGenParams;
+
+// Defaults: the built-in level's size, seed 1 and density 0.5
+void levelgen_defaults(LevelGenParams *params);
+
+// Generate a level. Returns -1 if the size is out of range (at least
+// LEVELGEN_MIN_WIDTH x LEVELGEN_MIN_HEIGHT) or out of memory.
+int level_generate(Level *level, const LevelGenParams *params);
+
+#endif
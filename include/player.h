@@ -3,6 +3,11 @@
 
 #include <stdbool.h>
 
+// Collision box: PLAYER_HALF_WIDTH either side of x, PLAYER_HEIGHT down
+// from y
+#define PLAYER_HALF_WIDTH 0.4f
+#define PLAYER_HEIGHT 1.0f
+
 typedef enum {
   ANIM_IDLE,
   ANIM_WALK,
@@ -0,0 +1,59 @@
+#ifndef PRESENT_H
+#define PRESENT_H
+
+#include "render.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+/*
+ * Output thread
+ *
+ * The simulation publishes finished frames into a lock-free triple buffer
+ * and never waits on the terminal. A separate thread picks up the newest
+ * frame, diffs it against what the terminal shows and writes it out.
+ * Frames published while the output thread is busy are replaced by newer
+ * ones and counted as dropped.
+ */
+
+// One published frame: the cells plus the scroll hints the renderer needs
+typedef struct {
+  Cell *cells;
+  int origin_x;
+  int origin_y;
+  int scroll_top;
+  int scroll_bottom;
+} PresentFrame;
+
+typedef struct {
+  PresentFrame slots[3];
+  int back;   // Slot owned by the simulation thread
+  int middle; // Shared slot index, PRESENT_FRESH set when unconsumed (atomic)
+  int front;  // Slot owned by the output thread
+
+  ScreenBuffer *screen; // Output thread's buffer; front mirrors the terminal
+  pthread_t thread;
+  int wake_pipe[2]; // Written by publish, polled by the output thread
+  bool running;     // Cleared to stop the output thread (atomic)
+
+  long frames_published; // Updated by the simulation thread
+  long frames_presented; // Updated by the output thread (atomic)
+  long frames_dropped;   // Frames replaced before being presented (atomic)
+} Presenter;
+
+// Create a presenter for frames of the given size and start its thread
+Presenter *presenter_create(int width, int height);
+
+// Stop the output thread after it presents the last published frame
+void presenter_stop(Presenter *p);
+
+// Stop the output thread if still running and free the presenter
+void presenter_destroy(Presenter *p);
+
+// Hand the frame in sb to the output thread. sb's cell buffer is swapped
+// with a free slot, so every cell must be redrawn before the next publish.
+void presenter_publish(Presenter *p, ScreenBuffer *sb);
+
+// Copy the frame counters
+void presenter_get_stats(Presenter *p, long *presented, long *dropped);
+
+#endif
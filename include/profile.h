@@ -0,0 +1,78 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Frame Profiler
+ *
+ * PROF_BEGIN/PROF_END pairs time a phase of the frame and feed a per-phase
+ * latency histogram, plus a Chrome trace-event log when tracing is on.
+ * The macros compile to nothing unless TARIO_PROFILE is defined (debug
+ * builds and `make profile`), so release builds pay nothing.
+ */
+
+#if defined(DEBUG) && !defined(TARIO_PROFILE)
+#define TARIO_PROFILE
+#endif
+
+typedef enum {
+  PROF_FRAME,      // Simulation and render, excluding the wait
+  PROF_INPUT,      // game_handle_input()
+  PROF_UPDATE,     // player_update()
+  PROF_COLLISIONS, // check_collisions()
+  PROF_ENTITIES,   // entity_update()
+  PROF_RENDER,     // game_render() composing the frame
+  PROF_PRESENT,    // screen_buffer_render() diffing and writing
+  PROF_PHASE_COUNT
+} ProfPhase;
+
+// Latency summary for one phase, in milliseconds
+typedef struct {
+  long count;
+  double mean_ms;
+  double p50_ms;
+  double p99_ms;
+  double max_ms;
+} ProfStats;
+
+#ifdef TARIO_PROFILE
+#define PROF_BEGIN(phase) uint64_t prof_start_##phase = profile_now_ns()
+#define PROF_END(phase)                                                        \
+  profile_record(phase, prof_start_##phase, profile_now_ns())
+#else
+#define PROF_BEGIN(phase)                                                      \
+  do {                                                                         \
+  } while (0)
+#define PROF_END(phase)                                                        \
+  do {                                                                         \
+  } while (0)
+#endif
+
+// True when this build records timings
+bool profile_enabled(void);
+
+// Monotonic clock in nanoseconds
+uint64_t profile_now_ns(void);
+
+// Record one timed phase; safe to call from the output thread for
+// PROF_PRESENT while the main thread records the other phases
+void profile_record(ProfPhase phase, uint64_t start_ns, uint64_t end_ns);
+
+// Summarize a phase's histogram
+void profile_get_stats(ProfPhase phase, ProfStats *stats);
+
+// Short display name of a phase
+const char *profile_phase_name(ProfPhase phase);
+
+// Start keeping trace events for profile_trace_write()
+int profile_trace_start(void);
+
+// Write recorded events as Chrome trace-event JSON and stop tracing
+int profile_trace_write(const char *path);
+
+// Clear histograms and trace events
+void profile_reset(void);
+
+#endif
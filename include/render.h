@@ -2,12 +2,38 @@
 #define RENDER_H
 
 #include "terminal.h"
+#include <stdbool.h>
+
+// One screen cell: glyph plus colors (TermColor) and ATTR_* bits
+typedef struct {
+  char ch;
+  unsigned char fg;
+  unsigned char bg;
+  unsigned char attr;
+} Cell;
+
+// Cell drawn by screen_buffer_clear() and screen_buffer_draw_char()
+#define CELL_BLANK ((Cell){' ', COLOR_DEFAULT, COLOR_DEFAULT, ATTR_NONE})
 
 // Screen buffer for double buffering
 typedef struct {
-  char *buffer;
+  Cell *buffer; // Back buffer, drawn into each frame
+  Cell *front;  // What the terminal currently shows
   int width;
   int height;
+  bool full_redraw; // Repaint everything on the next render
+  int style;        // SGR style the terminal is in, -1 if unknown
+
+  // Camera scroll tracking: rows [scroll_top, scroll_bottom) show the world
+  // from origin_x/origin_y; front_origin_* is the origin the terminal shows.
+  // Pure camera pans are sent as terminal scrolls instead of repaints.
+  bool scroll_enabled;
+  int scroll_top;
+  int scroll_bottom;
+  int origin_x;
+  int origin_y;
+  int front_origin_x;
+  int front_origin_y;
 } ScreenBuffer;
 
 // Create a new screen buffer
@@ -19,13 +45,36 @@ void screen_buffer_free(ScreenBuffer *sb);
 // Clear the buffer
 void screen_buffer_clear(ScreenBuffer *sb);
 
-// Draw a character at position
+// Draw a character at position using the default style
 void screen_buffer_draw_char(ScreenBuffer *sb, int x, int y, char c);
 
+// Draw a styled cell at position
+void screen_buffer_draw_cell(ScreenBuffer *sb, int x, int y, Cell cell);
+
+// Fill count cells of row y starting at column x (clipped to the buffer)
+void screen_buffer_fill_row(ScreenBuffer *sb, int x, int y, int count,
+                            Cell cell);
+
+// Copy count tiles into row y starting at column x, mapping each tile byte
+// through a 256-entry lookup table. The run is clipped to the buffer.
+void screen_buffer_blit_row(ScreenBuffer *sb, int x, int y,
+                            const unsigned char *tiles, int count,
+                            const Cell *lut);
+
 // Draw a string at position
 void screen_buffer_draw_string(ScreenBuffer *sb, int x, int y, const char *str);
 
-// Render buffer to screen
+// Set the rows that follow the camera (scroll_bottom exclusive); an empty
+// region disables scroll detection
+void screen_buffer_set_scroll_region(ScreenBuffer *sb, int top, int bottom);
+
+// Set the world origin shown by the scroll region in the back buffer
+void screen_buffer_set_origin(ScreenBuffer *sb, int x, int y);
+
+// Force the next render to repaint every cell (e.g. after a screen clear)
+void screen_buffer_invalidate(ScreenBuffer *sb);
+
+// Render buffer to screen, emitting only cells that changed since last render
 void screen_buffer_render(ScreenBuffer *sb);
 
 #endif
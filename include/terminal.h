@@ -1,24 +1,134 @@
 #ifndef TERMINAL_H
 #define TERMINAL_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <termios.h>
 
+// Where frames go and where input comes from
+typedef enum {
+  TERM_BACKEND_TTY,    // Raw-mode terminal on stdin/stdout
+  TERM_BACKEND_MEMORY, // Frames captured in memory (term_captured_output())
+  TERM_BACKEND_FILE,   // Frames written to a file
+  TERM_BACKEND_NULL    // Frames discarded
+} TermBackend;
+
+// Optional terminal features, detected at startup
+typedef struct {
+  bool sync_output;    // Synchronized update mode (DEC private mode 2026)
+  bool truecolor;      // 24-bit SGR colors
+  bool kitty_keyboard; // Kitty progressive keyboard protocol
+  bool scroll_regions; // DECSTBM scroll margins, SU/SD and ICH/DCH
+} TermCaps;
+
 // Terminal state
 typedef struct {
   struct termios orig_termios;
   int width;
   int height;
+  TermBackend backend;
+  TermCaps caps;
 } Terminal;
 
+// Terminal colors (SGR 30-37 / 40-47); COLOR_DEFAULT keeps the terminal's own
+typedef enum {
+  COLOR_BLACK = 0,
+  COLOR_RED = 1,
+  COLOR_GREEN = 2,
+  COLOR_YELLOW = 3,
+  COLOR_BLUE = 4,
+  COLOR_MAGENTA = 5,
+  COLOR_CYAN = 6,
+  COLOR_WHITE = 7,
+  COLOR_DEFAULT = 9
+} TermColor;
+
+// Text attribute bits
+#define ATTR_NONE 0x0
+#define ATTR_BOLD 0x1
+#define ATTR_DIM 0x2
+#define ATTR_UNDERLINE 0x4
+#define ATTR_REVERSE 0x8
+
+// Output statistics for the frame output buffer
+typedef struct {
+  size_t frame_bytes;  // Bytes sent by the last flush
+  int frame_syscalls;  // write() calls made by the last flush
+  size_t total_bytes;  // Bytes sent since startup
+  long total_syscalls; // write() calls since startup
+  long flushes;        // Number of non-empty flushes since startup
+} TermStats;
+
 // Initialize terminal in raw mode
 int terminal_init(Terminal *term);
 
+// Initialize a headless terminal of the given size. Input comes from the
+// script set with term_set_input_script(); path is only used by
+// TERM_BACKEND_FILE.
+int terminal_init_headless(Terminal *term, TermBackend backend,
+                           const char *path, int width, int height);
+
 // Restore terminal to original state
 void terminal_restore(Terminal *term);
 
 // Get terminal size
 void terminal_get_size(Terminal *term);
 
+// Detect terminal capabilities: a table keyed by $TERM (plus $COLORTERM)
+// gives the defaults, then DECRQM and kitty keyboard queries confirm what
+// the terminal actually answers. $TARIO_CAPS overrides the result, e.g.
+// TARIO_CAPS=-sync,+truecolor (names: sync, truecolor, kitty, scroll).
+void terminal_detect_caps(Terminal *term);
+
+// Send the capability queries and update term->caps from the answers.
+// Called by terminal_detect_caps() on a tty; headless backends send nothing
+// and take the answers from one line of the input script.
+void terminal_query_caps(Terminal *term);
+
+// Keys typed while the queries were being answered, which the answers were
+// read along with. Copies up to size bytes and returns the count.
+int term_take_probe_input(char *buf, int size);
+
+// Capabilities the output path currently uses, and a way to change them
+const TermCaps *term_caps(void);
+void term_set_caps(const TermCaps *caps);
+
+// Bracket a frame in synchronized-update mode when the terminal supports
+// it, so it is shown all at once. A frame that added no output drops the
+// brackets again.
+void term_sync_begin(void);
+void term_sync_end(void);
+
+// Frame output buffer: all term_* helpers append here, nothing reaches the
+// terminal until term_flush() sends the whole frame with a single write()
+void term_write(const char *data, size_t len);
+void term_flush(void);
+void term_get_stats(TermStats *stats);
+
+// Bytes written to the terminal but not yet transmitted by the tty driver.
+// Returns 0 when the output is not a tty or the query is unsupported.
+int term_output_pending(void);
+
+// Rendering holds off while more than this many bytes are still queued;
+// frames skipped meanwhile merge into the next one through the diff renderer
+#define TERM_OUTPUT_BACKLOG_LIMIT 1024
+
+// Frames captured by TERM_BACKEND_MEMORY since init or the last clear
+const char *term_captured_output(size_t *len);
+void term_clear_captured_output(void);
+
+// Read pending input bytes without blocking; returns the count read
+int term_read_input(char *buf, int size);
+
+// File descriptor to poll for input readiness, or -1 for headless backends
+int term_input_fd(void);
+
+// Scripted input for headless runs: one line of keys per frame. Each line
+// is returned by term_read_input() followed by one empty read, which ends
+// that frame's input. The script must outlive the run.
+void term_set_input_script(const char *script);
+bool term_input_script_done(void);
+
 // ANSI escape code functions
 void term_clear_screen(void);
 void term_move_cursor(int x, int y);
@@ -27,4 +137,17 @@ void term_show_cursor(void);
 void term_set_color(int fg, int bg);
 void term_reset_color(void);
 
+// Scrolling: rows [top, bottom) become the scroll region (DECSTBM), which
+// SU/SD then shift; ICH/DCH shift the cursor's row right/left by n cells
+void term_set_scroll_region(int top, int bottom);
+void term_reset_scroll_region(void);
+void term_scroll_up(int n);
+void term_scroll_down(int n);
+void term_insert_chars(int n);
+void term_delete_chars(int n);
+
+// Select a complete style (colors and attributes) with one SGR sequence.
+// Sequences are encoded once per style and cached.
+void term_set_style(int fg, int bg, int attr);
+
 #endif
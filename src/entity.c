@@ -0,0 +1,207 @@
+#include "entity.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ENTITY_GRAVITY 25.0f
+#define ENTITY_MAX_FALL 20.0f
+#define ENTITY_WALK_SPEED 3.0f
+#define ENTITY_HOP_FORCE 10.0f
+#define ENTITY_HOP_INTERVAL 1.5f
+#define ENTITY_HALF_WIDTH 0.4f
+#define ENTITY_HEIGHT 1.0f
+
+// Longest step simulated at once: nothing moves a whole tile per step, so
+// collisions can test the tiles an entity ends up in rather than sweep
+#define ENTITY_MAX_STEP (0.9f / ENTITY_MAX_FALL)
+
+// Component arrays are aligned for full-width vector loads
+#define ENTITY_ALIGN 32
+
+void entity_store_init(EntityStore *store) { memset(store, 0, sizeof(*store)); }
+
+void entity_store_free(EntityStore *store) {
+  free(store->x);
+  free(store->y);
+  free(store->vel_x);
+  free(store->vel_y);
+  free(store->timer);
+  free(store->flags);
+  free(store->type);
+  entity_store_init(store);
+}
+
+// Move one component array to a larger aligned block
+static int grow_array(void **array, size_t elem, int count, int capacity) {
+  void *grown;
+  if (posix_memalign(&grown, ENTITY_ALIGN, elem * capacity) != 0)
+    return -1;
+  if (count > 0)
+    memcpy(grown, *array, elem * count);
+  free(*array);
+  *array = grown;
+  return 0;
+}
+
+static int entity_reserve(EntityStore *store, int capacity) {
+  int n = store->count;
+  if (grow_array((void **)&store->x, sizeof(float), n, capacity) != 0 ||
+      grow_array((void **)&store->y, sizeof(float), n, capacity) != 0 ||
+      grow_array((void **)&store->vel_x, sizeof(float), n, capacity) != 0 ||
+      grow_array((void **)&store->vel_y, sizeof(float), n, capacity) != 0 ||
+      grow_array((void **)&store->timer, sizeof(float), n, capacity) != 0 ||
+      grow_array((void **)&store->flags, 1, n, capacity) != 0 ||
+      grow_array((void **)&store->type, 1, n, capacity) != 0)
+    return -1; // Arrays already grown stay valid for count entities
+  store->capacity = capacity;
+  return 0;
+}
+
+int entity_spawn(EntityStore *store, EntityType type, float x, float y) {
+  if (store->count == store->capacity &&
+      entity_reserve(store, store->capacity ? store->capacity * 2 : 64) != 0)
+    return -1;
+
+  int i = store->count++;
+  store->x[i] = x;
+  store->y[i] = y;
+  store->vel_x[i] = ENTITY_WALK_SPEED;
+  store->vel_y[i] = 0.0f;
+  store->timer[i] = ENTITY_HOP_INTERVAL;
+  store->flags[i] = type == ENTITY_JUMPER ? ENTITY_FLAG_HOPS : 0;
+  store->type[i] = (uint8_t)type;
+  return i;
+}
+
+void entity_remove(EntityStore *store, int index) {
+  int last = --store->count;
+  store->x[index] = store->x[last];
+  store->y[index] = store->y[last];
+  store->vel_x[index] = store->vel_x[last];
+  store->vel_y[index] = store->vel_y[last];
+  store->timer[index] = store->timer[last];
+  store->flags[index] = store->flags[last];
+  store->type[index] = store->type[last];
+}
+
+// Gravity, movement and hop timers for every entity
+static void integrate(int n, float *restrict x, float *restrict y,
+                      const float *restrict vel_x, float *restrict vel_y,
+                      float *restrict timer, float dt) {
+  for (int i = 0; i < n; i++) {
+    float vy = vel_y[i] + ENTITY_GRAVITY * dt;
+    vy = vy < ENTITY_MAX_FALL ? vy : ENTITY_MAX_FALL;
+    vel_y[i] = vy;
+    x[i] += vel_x[i] * dt;
+    y[i] += vy * dt;
+    float t = timer[i] - dt;
+    timer[i] = t > 0.0f ? t : 0.0f;
+  }
+}
+
+// Jumpers on the ground whose timer ran out hop. The hop is blended in
+// arithmetically, which vectorizes where a branch would not.
+static void hop(int n, const uint8_t *restrict flags, float *restrict vel_y,
+                float *restrict timer) {
+  const int ready = ENTITY_FLAG_HOPS | ENTITY_FLAG_ON_GROUND;
+  for (int i = 0; i < n; i++) {
+    float t = timer[i];
+    float jump = (flags[i] & ready) == ready && t <= 0.0f ? 1.0f : 0.0f;
+    vel_y[i] += jump * (-ENTITY_HOP_FORCE - vel_y[i]);
+    timer[i] = t + jump * ENTITY_HOP_INTERVAL;
+  }
+}
+
+static unsigned flags_at(Level *level, float x, float y) {
+  return level_tile_flags[level_get_tile(level, (int)floorf(x),
+                                         (int)floorf(y))];
+}
+
+// Settle each entity against the tiles it moved into this step
+static void collide(EntityStore *store, Level *level, float dt) {
+  for (int i = 0; i < store->count; i++) {
+    float x = store->x[i];
+    float y = store->y[i];
+    float vx = store->vel_x[i];
+    float vy = store->vel_y[i];
+    float left = x - ENTITY_HALF_WIDTH;
+    float right = x + ENTITY_HALF_WIDTH - 1e-4f;
+    uint8_t flags = store->flags[i] & ~ENTITY_FLAG_ON_GROUND;
+
+    // Over a streamed chunk not loaded yet: wait rather than fall through
+    if (!level_tile_loaded(level, (int)floorf(x),
+                           (int)floorf(y + ENTITY_HEIGHT))) {
+      store->x[i] = x - vx * dt;
+      store->y[i] = y - vy * dt;
+      store->vel_y[i] = 0.0f;
+      continue;
+    }
+
+    if (vy >= 0.0f) {
+      // Land on a floor or platform whose top the feet crossed
+      float feet = y + ENTITY_HEIGHT;
+      float row = floorf(feet);
+      unsigned below =
+          flags_at(level, left, feet) | flags_at(level, right, feet);
+      if (feet - vy * dt <= row + 1e-4f &&
+          (below & (TILE_FLAG_SOLID | TILE_FLAG_ONE_WAY))) {
+        y = row - ENTITY_HEIGHT;
+        vy = 0.0f;
+        flags |= ENTITY_FLAG_ON_GROUND;
+      }
+    } else if ((flags_at(level, left, y) | flags_at(level, right, y)) &
+               TILE_FLAG_SOLID) {
+      y = floorf(y) + 1.0f;
+      vy = 0.0f;
+    }
+
+    // Turn at walls, and walkers also at ledges
+    float edge = vx > 0.0f ? right : left;
+    float ahead = vx > 0.0f ? right + 0.5f : left - 0.5f;
+    bool wall = flags_at(level, edge, y + ENTITY_HEIGHT * 0.5f) &
+                TILE_FLAG_SOLID;
+    bool ledge = store->type[i] == ENTITY_WALKER &&
+                 (flags & ENTITY_FLAG_ON_GROUND) &&
+                 !(flags_at(level, ahead, y + ENTITY_HEIGHT + 0.5f) &
+                   (TILE_FLAG_SOLID | TILE_FLAG_ONE_WAY));
+    if (wall || ledge) {
+      if (wall)
+        x -= vx * dt;
+      vx = -vx;
+    }
+
+    store->x[i] = x;
+    store->y[i] = y;
+    store->vel_x[i] = vx;
+    store->vel_y[i] = vy;
+    store->flags[i] = flags;
+  }
+}
+
+void entity_update(EntityStore *store, Level *level, float dt) {
+  int steps = (int)ceilf(dt / ENTITY_MAX_STEP);
+  float step = dt / (steps > 0 ? steps : 1);
+
+  for (int s = 0; s < steps; s++) {
+    hop(store->count, store->flags, store->vel_y, store->timer);
+    integrate(store->count, store->x, store->y, store->vel_x, store->vel_y,
+              store->timer, step);
+    collide(store, level, step);
+  }
+
+  // Fallen out of the level
+  for (int i = store->count - 1; i >= 0; i--) {
+    if (store->y[i] >= level->height)
+      entity_remove(store, i);
+  }
+}
+
+int entity_count_active(const EntityStore *store, const Level *level) {
+  int active = 0;
+  for (int i = 0; i < store->count; i++) {
+    if (level_tile_loaded(level, (int)floorf(store->x[i]),
+                          (int)floorf(store->y[i] + ENTITY_HEIGHT)))
+      active++;
+  }
+  return active;
+}
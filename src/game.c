@@ -1,10 +1,56 @@
 #include "game.h"
+#include "profile.h"
+#include <errno.h>
 #include <math.h>
+#include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+// Frames are paced to a tick this far apart
+#define FRAME_INTERVAL_NS 16666667L
+
+// Tick interval while the player stands still with nothing animating
+#define RESTING_INTERVAL_NS 100000000L
+
+// Longest stretch of real time simulated in one frame after a stall
+#define MAX_FRAME_TIME 0.1
+
+// Screen cell drawn for each tile, indexed by TileType character
+static Cell tile_cells[256];
+
+static void init_tile_cells(void) {
+  for (int i = 0; i < 256; i++) {
+    tile_cells[i] = CELL_BLANK;
+    tile_cells[i].ch = (char)i;
+  }
+
+  tile_cells[TILE_GROUND].fg = COLOR_GREEN;
+  tile_cells[TILE_COIN].fg = COLOR_YELLOW;
+  tile_cells[TILE_COIN].attr = ATTR_BOLD;
+  tile_cells[TILE_SPIKE].fg = COLOR_RED;
+  tile_cells[TILE_SPIKE].attr = ATTR_BOLD;
+  tile_cells[TILE_GOAL].fg = COLOR_MAGENTA;
+  tile_cells[TILE_GOAL].attr = ATTR_BOLD;
+  tile_cells[TILE_PLATFORM].fg = COLOR_CYAN;
+  tile_cells[TILE_QUESTION].fg = COLOR_YELLOW;
+  tile_cells[TILE_QUESTION].attr = ATTR_REVERSE;
+  tile_cells[TILE_PIPE_LEFT].fg = COLOR_GREEN;
+  tile_cells[TILE_PIPE_LEFT].attr = ATTR_BOLD;
+  tile_cells[TILE_PIPE_RIGHT].fg = COLOR_GREEN;
+  tile_cells[TILE_PIPE_RIGHT].attr = ATTR_BOLD;
+}
+
+static const Cell entity_cells[ENTITY_TYPE_COUNT] = {
+    [ENTITY_WALKER] = {'@', COLOR_RED, COLOR_DEFAULT, ATTR_BOLD},
+    [ENTITY_JUMPER] = {'&', COLOR_RED, COLOR_DEFAULT, ATTR_BOLD},
+};
 
 static double get_time(void) {
   struct timespec ts;
@@ -26,15 +72,119 @@ static void update_camera(Game *game) {
     game->camera_x = 0;
   if (game->camera_y < 0)
     game->camera_y = 0;
-  if (game->camera_x > LEVEL_WIDTH - viewport_width) {
-    game->camera_x = LEVEL_WIDTH - viewport_width;
+  if (game->camera_x > game->level.width - viewport_width) {
+    game->camera_x = game->level.width - viewport_width;
+  }
+  if (game->camera_y > game->level.height - viewport_height) {
+    game->camera_y = game->level.height - viewport_height;
+  }
+}
+
+// Ask a streamed level for the chunks around the view, reading further
+// ahead in the direction the player is running
+static void stream_prefetch(Game *game) {
+  int lead = (int)(game->player.vel_x * GAME_STREAM_LEAD);
+  level_stream_update(&game->level, (int)game->camera_x, (int)game->camera_y,
+                      game->screen->width, game->screen->height - 2, lead);
+}
+
+// Edges within SWEEP_EPSILON of a tile boundary count as on it, so a box
+// resting against a tile does not overlap it but a move that reaches a
+// tile makes contact
+#define SWEEP_EPSILON 1e-4f
+
+// First tile at or after position lo, not counting one it merely touches
+static int span_first(float lo) { return (int)floorf(lo + SWEEP_EPSILON); }
+
+// Last tile at or before position hi, not counting one it merely touches
+static int span_last(float hi) { return (int)ceilf(hi - SWEEP_EPSILON) - 1; }
+
+// Move the player horizontally to to_x, stopping against the first solid
+// column its leading edge reaches. Returns true on contact.
+static bool sweep_x(Level *level, Player *p, float to_x) {
+  int row0 = span_first(p->y);
+  int row1 = span_last(p->y + PLAYER_HEIGHT);
+
+  if (to_x > p->x) {
+    float edge = p->x + PLAYER_HALF_WIDTH;
+    int col0 = span_last(edge) + 1;
+    int col1 = span_first(edge + (to_x - p->x));
+    int hit = -1;
+    for (int row = row0; row <= row1; row++) {
+      int col = level_row_find_first(level, TILE_FLAG_SOLID, row, col0, col1);
+      if (col != -1 && (hit == -1 || col < hit))
+        hit = col;
+    }
+    if (hit != -1) {
+      p->x = hit - PLAYER_HALF_WIDTH;
+      return true;
+    }
+  } else if (to_x < p->x) {
+    float edge = p->x - PLAYER_HALF_WIDTH;
+    int col0 = span_last(edge + (to_x - p->x));
+    int col1 = span_first(edge) - 1;
+    int hit = -1;
+    for (int row = row0; row <= row1; row++) {
+      int col = level_row_find_last(level, TILE_FLAG_SOLID, row, col0, col1);
+      if (col > hit)
+        hit = col;
+    }
+    if (hit != -1) {
+      p->x = hit + 1 + PLAYER_HALF_WIDTH;
+      return true;
+    }
+  }
+  p->x = to_x;
+  return false;
+}
+
+// Move the player vertically to to_y, walking the rows its leading edge
+// crosses in order. Falling stops on the first solid or one-way row (feet
+// always start above rows they cross); rising stops under the first solid
+// row. Returns 1 when landing, -1 when hitting a ceiling, 0 otherwise.
+static int sweep_y(Level *level, Player *p, float to_y) {
+  int col0 = span_first(p->x - PLAYER_HALF_WIDTH);
+  int col1 = span_last(p->x + PLAYER_HALF_WIDTH);
+
+  if (to_y > p->y) {
+    float feet = p->y + PLAYER_HEIGHT;
+    int row1 = span_first(feet + (to_y - p->y));
+    for (int row = span_last(feet) + 1; row <= row1; row++) {
+      if (level_row_find_first(level, TILE_FLAG_SOLID | TILE_FLAG_ONE_WAY,
+                               row, col0, col1) != -1) {
+        p->y = row - PLAYER_HEIGHT;
+        return 1;
+      }
+    }
+  } else if (to_y < p->y) {
+    int row0 = span_last(to_y);
+    for (int row = span_first(p->y) - 1; row >= row0; row--) {
+      if (level_row_find_first(level, TILE_FLAG_SOLID, row, col0, col1) !=
+          -1) {
+        p->y = row + 1;
+        return -1;
+      }
+    }
   }
-  if (game->camera_y > LEVEL_HEIGHT - viewport_height) {
-    game->camera_y = LEVEL_HEIGHT - viewport_height;
+  p->y = to_y;
+  return 0;
+}
+
+// True when every tile from (x0, y0) to (x1, y1) inclusive is loaded,
+// testing one tile per chunk
+static bool area_loaded(Level *level, int x0, int y0, int x1, int y1) {
+  for (int y = y0; y <= y1 + LEVEL_CHUNK_SIZE - 1; y += LEVEL_CHUNK_SIZE) {
+    for (int x = x0; x <= x1 + LEVEL_CHUNK_SIZE - 1; x += LEVEL_CHUNK_SIZE) {
+      if (!level_tile_loaded(level, x < x1 ? x : x1, y < y1 ? y : y1))
+        return false;
+    }
   }
+  return true;
 }
 
-static void check_collisions(Game *game) {
+// Resolve the move player_update() made this tick, from (from_x, from_y),
+// against the level, then apply whatever the player ends up touching
+static void check_collisions(Game *game, float from_x, float from_y) {
   Player *p = &game->player;
   Level *level = &game->level;
 
@@ -45,28 +195,33 @@ static void check_collisions(Game *game) {
   bool was_on_ground = p->on_ground;
   p->on_ground = false;
 
-  // Check ground collision (including one-way platforms)
-  int player_bottom = (int)(p->y + 1);
-  int player_x = (int)p->x;
-
-  // Check solid tiles
-  if (player_bottom >= 0 && player_bottom < LEVEL_HEIGHT) {
-    if (level_is_solid(level, player_x, player_bottom) && p->vel_y >= 0) {
-      p->y = player_bottom - 1;
-      p->vel_y = 0;
-      p->on_ground = true;
-    }
+  // Sweep the box along the motion one axis at a time, so no tile between
+  // the two positions is skipped however far the player moved
+  float to_x = p->x;
+  float to_y = p->y;
+  p->x = from_x;
+  p->y = from_y;
+
+  // Chunks of a streamed level not loaded yet read as air; hold still over
+  // them, down to the row under the feet, rather than fall through
+  if (!area_loaded(level,
+                   span_first(fminf(from_x, to_x) - PLAYER_HALF_WIDTH),
+                   span_first(fminf(from_y, to_y)),
+                   span_last(fmaxf(from_x, to_x) + PLAYER_HALF_WIDTH),
+                   (int)(fmaxf(from_y, to_y) + PLAYER_HEIGHT))) {
+    p->vel_x = 0;
+    p->vel_y = 0;
+    p->on_ground = was_on_ground;
+    return;
   }
 
-  // Check one-way platforms (can only land on from above)
-  if (!p->on_ground && p->vel_y >= 0) {
-    int check_y = (int)(p->y + 0.5f);
-    if (level_is_platform(level, player_x, check_y + 1) && p->y < check_y + 1) {
-      p->y = check_y;
-      p->vel_y = 0;
-      p->on_ground = true;
-    }
-  }
+  if (sweep_x(level, p, to_x))
+    p->vel_x = 0;
+  int contact = sweep_y(level, p, to_y);
+  if (contact != 0)
+    p->vel_y = 0;
+  if (contact > 0)
+    p->on_ground = true;
 
   // Reset coyote timer when landing
   if (p->on_ground && !was_on_ground) {
@@ -84,70 +239,85 @@ static void check_collisions(Game *game) {
   }
 
   // Fall off bottom of level = death
-  if (player_bottom >= LEVEL_HEIGHT) {
+  if ((int)(p->y + PLAYER_HEIGHT) >= level->height) {
     player_kill(p);
     return;
   }
 
-  // Check ceiling collision
-  int player_top = (int)p->y;
-  if (player_top >= 0 && level_is_solid(level, player_x, player_top) &&
-      p->vel_y < 0) {
-    p->vel_y = 0;
-    p->y = player_top + 1;
-  }
-
-  // Check left/right collisions
-  int player_y = (int)p->y;
-  int player_left = (int)(p->x - 0.5f);
-  int player_right = (int)(p->x + 0.5f);
-
-  if (level_is_solid(level, player_left, player_y) && p->vel_x < 0) {
-    p->vel_x = 0;
-    p->x = player_left + 1.5f;
-  }
-  if (level_is_solid(level, player_right, player_y) && p->vel_x > 0) {
-    p->vel_x = 0;
-    p->x = player_right - 0.5f;
-  }
+  // One pass over the tiles the box overlaps for anything touched on
+  // contact; usually there is nothing and the checks below are skipped
+  int left = span_first(p->x - PLAYER_HALF_WIDTH);
+  int right = span_last(p->x + PLAYER_HALF_WIDTH);
+  int top = span_first(p->y);
+  int bottom = span_last(p->y + PLAYER_HEIGHT);
+  TileQuery touched = level_query_rect(level, left, top, right, bottom);
+  if (!(touched.any &
+        (TILE_FLAG_DEADLY | TILE_FLAG_GOAL | TILE_FLAG_COLLECTIBLE)))
+    return;
 
   // Check for spikes
-  if (level_is_deadly(level, player_x, player_y) ||
-      level_is_deadly(level, player_x, player_bottom)) {
+  if (touched.any & TILE_FLAG_DEADLY) {
     player_kill(p);
     return;
   }
 
   // Check for goal
-  if (level_is_goal(level, player_x, player_y) ||
-      level_is_goal(level, player_x, player_top)) {
+  if (touched.any & TILE_FLAG_GOAL) {
     game->victory = true;
   }
 
   // Collect coins
-  if (level_is_coin(level, player_x, player_y)) {
-    level_collect_coin(level, player_x, player_y);
-    p->coins_collected++;
-  }
-  if (level_is_coin(level, player_x, player_top)) {
-    level_collect_coin(level, player_x, player_top);
-    p->coins_collected++;
+  for (int y = top; y <= bottom; y++) {
+    for (int x = left; x <= right; x++) {
+      if (level_is_coin(level, x, y)) {
+        level_collect_coin(level, x, y);
+        p->coins_collected++;
+      }
+    }
   }
 }
 
+// Back to the spawn point after a death, with the level as it was at the
+// last checkpoint: coins taken since then are put back
 static void respawn_player(Game *game) {
   int saved_lives = game->player.lives;
-  int saved_coins = game->player.coins_collected;
+  level_rollback(&game->level, game->checkpoint);
   player_init(&game->player, game->spawn_x, game->spawn_y);
   game->player.lives = saved_lives;
-  game->player.coins_collected = saved_coins;
+  game->player.coins_collected = (int)game->level.items.coins_collected;
 }
 
-int game_init(Game *game) {
-  if (terminal_init(&game->terminal) != 0) {
-    return -1;
-  }
+// Make rendering start from the current state, e.g. after a teleport
+static void snap_interpolation(Game *game) {
+  game->prev_x = game->player.x;
+  game->prev_y = game->player.y;
+  game->prev_camera_x = game->camera_x;
+  game->prev_camera_y = game->camera_y;
+}
+
+static float lerp(float from, float to, float alpha) {
+  return from + (to - from) * alpha;
+}
+
+// Put the player at the level's spawn point for a fresh attempt
+static void start_level(Game *game) {
+  game->spawn_x = (float)game->level.spawn_x;
+  game->spawn_y = (float)game->level.spawn_y;
+  game->checkpoint = level_checkpoint(&game->level);
+  player_init(&game->player, game->spawn_x, game->spawn_y);
+  game->victory = false;
+  update_camera(game);
+  stream_prefetch(game);
+  snap_interpolation(game);
+}
 
+void game_restart(Game *game) {
+  level_rollback(&game->level, 0);
+  start_level(game);
+}
+
+// Set up everything that does not depend on the terminal backend
+static int game_setup(Game *game) {
   game->screen =
       screen_buffer_create(game->terminal.width, game->terminal.height);
   if (!game->screen) {
@@ -155,110 +325,504 @@ int game_init(Game *game) {
     return -1;
   }
 
-  level_init(&game->level);
-
-  // Spawn player at start
-  game->spawn_x = 5.0f;
-  game->spawn_y = LEVEL_HEIGHT - 10.0f;
-  player_init(&game->player, game->spawn_x, game->spawn_y);
+  init_tile_cells();
+  entity_store_init(&game->entities);
+  if (level_init(&game->level) != 0) {
+    screen_buffer_free(game->screen);
+    terminal_restore(&game->terminal);
+    return -1;
+  }
 
   game->running = true;
   game->last_time = get_time();
-  game->camera_x = 0;
-  game->camera_y = 0;
   game->paused = false;
-  game->victory = false;
+  game->frames_rendered = 0;
+  game->frames_dropped = 0;
+  game->presenter = NULL;
+  game->tick = GAME_TICK;
+  game->accumulator = 0.0;
+  game->render_alpha = 1.0f;
+  game->show_profile = false;
+  input_init(&game->input);
+
+  // Keys pressed while the terminal answered the capability queries
+  char early[256];
+  int early_len = term_take_probe_input(early, sizeof(early));
+  input_feed(&game->input, early, early_len);
+  game->key_releases = term_caps()->kitty_keyboard;
+  game->held_left = false;
+  game->held_right = false;
+  game->pace = GAME_ACTIVE;
+  game->frames_resting = 0;
+  game->idle_waits = 0;
+  start_level(game);
 
   return 0;
 }
 
+int game_init(Game *game) {
+  if (terminal_init(&game->terminal) != 0) {
+    return -1;
+  }
+
+  if (game_setup(game) != 0) {
+    return -1;
+  }
+
+  // Terminal writes happen on the output thread from here on
+  game->presenter =
+      presenter_create(game->terminal.width, game->terminal.height);
+  if (!game->presenter) {
+    game_cleanup(game);
+    return -1;
+  }
+
+  return 0;
+}
+
+int game_init_headless(Game *game, TermBackend backend, const char *path,
+                       int width, int height) {
+  if (terminal_init_headless(&game->terminal, backend, path, width, height) !=
+      0) {
+    return -1;
+  }
+
+  return game_setup(game);
+}
+
+int game_load_level(Game *game, const char *path) {
+  Level level;
+  int result = level_file_is_binary(path)
+                   ? level_stream_open(&level, path, GAME_STREAM_BUDGET)
+                   : level_load(&level, path);
+  if (result != 0)
+    return -1;
+
+  game_set_level(game, &level);
+  return 0;
+}
+
+void game_set_level(Game *game, Level *level) {
+  level_free(&game->level);
+  game->level = *level;
+  game->entities.count = 0;
+  start_level(game);
+}
+
 void game_cleanup(Game *game) {
+  if (game->presenter) {
+    // Frames that reached the terminal vs. frames replaced by newer ones
+    presenter_stop(game->presenter);
+    presenter_get_stats(game->presenter, &game->frames_rendered,
+                        &game->frames_dropped);
+    presenter_destroy(game->presenter);
+    game->presenter = NULL;
+  }
   screen_buffer_free(game->screen);
+  level_free(&game->level);
+  entity_store_free(&game->entities);
   terminal_restore(&game->terminal);
+
+#ifdef DEBUG
+  TermStats stats;
+  term_get_stats(&stats);
+  if (stats.flushes > 0) {
+    fprintf(stderr, "Output: %ld frames, %.0f bytes/frame, %.2f writes/frame\n",
+            stats.flushes, (double)stats.total_bytes / stats.flushes,
+            (double)stats.total_syscalls / stats.flushes);
+  }
+  fprintf(stderr, "Frames: %ld rendered, %ld dropped\n", game->frames_rendered,
+          game->frames_dropped);
+  fprintf(stderr, "Idle: %ld frames at resting rate, %ld idle waits\n",
+          game->frames_resting, game->idle_waits);
+#endif
+}
+
+// Frame tick source: a periodic timerfd where available, otherwise poll()
+// timeouts towards an absolute deadline
+typedef struct {
+  int fd;                   // timerfd, or -1
+  long interval_ns;         // Current tick interval
+  struct timespec deadline; // Next tick when fd is -1
+} FrameTimer;
+
+static void frame_timer_open(FrameTimer *timer) {
+  timer->fd = -1;
+  timer->interval_ns = 0;
+  clock_gettime(CLOCK_MONOTONIC, &timer->deadline);
+#ifdef __linux__
+  timer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+#endif
+}
+
+// Switch the tick interval, restarting the tick phase from now
+static void frame_timer_set_interval(FrameTimer *timer, long interval_ns) {
+  if (timer->interval_ns == interval_ns)
+    return;
+  timer->interval_ns = interval_ns;
+  clock_gettime(CLOCK_MONOTONIC, &timer->deadline);
+#ifdef __linux__
+  if (timer->fd != -1) {
+    struct itimerspec tick = {{0, interval_ns}, {0, interval_ns}};
+    if (timerfd_settime(timer->fd, 0, &tick, NULL) == -1) {
+      close(timer->fd);
+      timer->fd = -1;
+    }
+  }
+#endif
+}
+
+static void frame_timer_close(FrameTimer *timer) {
+  if (timer->fd != -1)
+    close(timer->fd);
+  timer->fd = -1;
+}
+
+// Milliseconds until an absolute CLOCK_MONOTONIC deadline, rounded up
+static int ms_until(const struct timespec *deadline) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long ns = (deadline->tv_sec - now.tv_sec) * 1000000000L +
+            (deadline->tv_nsec - now.tv_nsec);
+  return ns > 0 ? (int)((ns + 999999) / 1000000) : 0;
+}
+
+GamePace game_pace(const Game *game) {
+  const Player *p = &game->player;
+  bool pending = input_waiting(&game->input);
+  bool at_rest = p->on_ground && !p->is_dead && p->vel_x == 0.0f &&
+                 p->vel_y == 0.0f && p->jump_buffer_timer <= 0.0f &&
+                 p->x == game->prev_x && p->y == game->prev_y &&
+                 !game->held_left && !game->held_right && !pending &&
+                 game->entities.count == 0;
+
+  // Victory keeps simulating, so it is only frozen once the player stops.
+  // Buffered input, e.g. a lone ESC, needs the loop awake to time it out.
+  if (!pending && (game->paused || (game->victory && at_rest)))
+    return GAME_IDLE;
+  return at_rest ? GAME_RESTING : GAME_ACTIVE;
+}
+
+// Wait for the next frame, handling input the moment it arrives. Active
+// play ticks at the full frame rate and a resting player at
+// RESTING_INTERVAL_NS; an idle game stops ticking and sleeps until input.
+// Input cuts a slow or idle wait short so the response is drawn at once.
+static void wait_for_frame(Game *game, FrameTimer *timer) {
+  GamePace pace = game_pace(game);
+  game->pace = pace;
+  frame_timer_set_interval(timer, pace == GAME_RESTING ? RESTING_INTERVAL_NS
+                                                       : FRAME_INTERVAL_NS);
+
+  // Without a timer fd, advance the deadline one tick; when more than a
+  // tick behind, restart from now instead of rushing through missed
+  // frames. A timerfd does the same by coalescing expirations.
+  if (timer->fd == -1) {
+    timer->deadline.tv_nsec += timer->interval_ns;
+    if (timer->deadline.tv_nsec >= 1000000000L) {
+      timer->deadline.tv_nsec -= 1000000000L;
+      timer->deadline.tv_sec++;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long behind_ns = (now.tv_sec - timer->deadline.tv_sec) * 1000000000L +
+                     (now.tv_nsec - timer->deadline.tv_nsec);
+    if (behind_ns > timer->interval_ns) {
+      timer->deadline = now;
+    }
+  }
+
+  // poll() skips negative fds, so a missing input or timer fd is harmless
+  bool idle = pace == GAME_IDLE;
+  struct pollfd fds[2] = {{term_input_fd(), POLLIN, 0},
+                          {idle ? -1 : timer->fd, POLLIN, 0}};
+  if (idle)
+    game->idle_waits++;
+
+  while (game->running) {
+    int timeout = -1;
+    if (!idle && timer->fd == -1)
+      timeout = ms_until(&timer->deadline);
+    int ready = poll(fds, 2, timeout);
+    if (ready < 0) {
+      if (errno == EINTR)
+        continue; // Signal; the handler may have cleared game->running
+      return;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      PROF_BEGIN(PROF_INPUT);
+      game_handle_input(game);
+      PROF_END(PROF_INPUT);
+      if (pace != GAME_ACTIVE)
+        break;
+    } else if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+      fds[0].fd = -1; // Input closed; keep ticking
+      if (idle)
+        return; // Nothing left to wake an idle wait
+    }
+
+    if (fds[1].revents & POLLIN) {
+      uint64_t expirations;
+      if (read(timer->fd, &expirations, sizeof(expirations)) < 0) {
+        // Spurious wakeup; the tick is still due
+      }
+      return;
+    }
+    if (!idle && timer->fd == -1 && ready == 0)
+      return;
+  }
+
+  // Time spent idle is not simulated
+  if (idle)
+    game->last_time = get_time();
 }
 
 void game_run(Game *game) {
+  FrameTimer timer;
+  frame_timer_open(&timer);
+  game->last_time = get_time();
+
+  // Input is handled while waiting for the tick, so the frame itself only
+  // simulates and renders
   while (game->running) {
     double current_time = get_time();
-    float delta_time = (float)(current_time - game->last_time);
+    double frame_time = current_time - game->last_time;
     game->last_time = current_time;
 
-    // Cap delta time to prevent huge jumps
-    if (delta_time > 0.1f)
-      delta_time = 0.1f;
+    // Cap catch-up time to prevent huge jumps after a stall
+    if (frame_time > MAX_FRAME_TIME)
+      frame_time = MAX_FRAME_TIME;
+    game->accumulator += frame_time;
 
-    game_handle_input(game);
-    if (!game->paused) {
-      game_update(game, delta_time);
+    PROF_BEGIN(PROF_FRAME);
+
+    // A lone ESC turns into the Escape key once its timeout passes
+    if (input_waiting(&game->input))
+      game_handle_input(game);
+
+    // Simulate in fixed ticks; leftover time carries to the next frame and
+    // sets how far rendering interpolates towards the current state
+    while (game->accumulator >= game->tick) {
+      game_step(game);
+      game->accumulator -= game->tick;
+    }
+    game->render_alpha = (float)(game->accumulator / game->tick);
+
+    // Simulation keeps running; only the frame is dropped when the terminal
+    // has not drained the previous one yet. The output thread does its own
+    // back-pressure handling.
+    if (!game->presenter &&
+        term_output_pending() > TERM_OUTPUT_BACKLOG_LIMIT) {
+      game->frames_dropped++;
+    } else {
+      game_render(game);
+      game->frames_rendered++;
     }
+    if (game->pace == GAME_RESTING)
+      game->frames_resting++;
+    PROF_END(PROF_FRAME);
+
+    wait_for_frame(game, &timer);
+  }
+
+  frame_timer_close(&timer);
+}
+
+int game_run_headless(Game *game, int max_frames) {
+  int frames = 0;
+
+  // Same pipeline as game_run() with one tick per frame and no sleeping
+  while (game->running && frames < max_frames) {
+    PROF_BEGIN(PROF_FRAME);
+    PROF_BEGIN(PROF_INPUT);
+    game_handle_input(game);
+    PROF_END(PROF_INPUT);
+    game_step(game);
+    game->render_alpha = 1.0f;
     game_render(game);
+    game->frames_rendered++;
+    frames++;
+    PROF_END(PROF_FRAME);
+  }
 
-    // Target 60 FPS
-    struct timespec sleep_time = {0, 16666667}; // ~16.67ms in nanoseconds
-    nanosleep(&sleep_time, NULL);
+  return frames;
+}
+
+void game_step(Game *game) {
+  snap_interpolation(game);
+  if (!game->paused) {
+    if (game->held_left)
+      player_move_left(&game->player);
+    if (game->held_right)
+      player_move_right(&game->player);
+    game_update(game, game->tick);
   }
 }
 
 void game_update(Game *game, float delta_time) {
   // Check for respawn
+  bool respawned = false;
   if (player_can_respawn(&game->player)) {
     if (game->player.lives > 0) {
       respawn_player(game);
+      respawned = true;
     } else {
       // Game over - could add game over screen here
       game->running = false;
     }
   }
 
+  float from_x = game->player.x;
+  float from_y = game->player.y;
+  PROF_BEGIN(PROF_UPDATE);
   player_update(&game->player, delta_time);
-  check_collisions(game);
+  PROF_END(PROF_UPDATE);
+
+  PROF_BEGIN(PROF_COLLISIONS);
+  check_collisions(game, from_x, from_y);
+  PROF_END(PROF_COLLISIONS);
+  PROF_BEGIN(PROF_ENTITIES);
+  entity_update(&game->entities, &game->level, delta_time);
+  PROF_END(PROF_ENTITIES);
   update_camera(game);
+  stream_prefetch(game);
+
+  // Don't interpolate across the jump back to the spawn point
+  if (respawned) {
+    snap_interpolation(game);
+  }
+}
+
+// Copy one screen row of the level, blanking columns outside the level
+static void render_level_row(Game *game, int y, int cam_x, int cam_y) {
+  ScreenBuffer *sb = game->screen;
+  int x = 0;
+
+  while (x < sb->width) {
+    int count;
+    const unsigned char *tiles =
+        level_get_row_span(&game->level, x + cam_x, y + cam_y, &count);
+    if (tiles) {
+      screen_buffer_blit_row(sb, x, y, tiles, count, tile_cells);
+      x += count;
+    } else {
+      // Left of the level: blank up to column 0; otherwise the rest of the row
+      int blank =
+          (x + cam_x < 0 && y + cam_y >= 0 && y + cam_y < game->level.height)
+              ? -(x + cam_x)
+              : sb->width - x;
+      screen_buffer_fill_row(sb, x, y, blank, CELL_BLANK);
+      x += blank;
+    }
+  }
+}
+
+// Frame timing overlay: whole-frame latency on the HUD line, per-phase
+// p50/p99 on the line below
+static void render_profile_overlay(Game *game, int hud_y, int hud_len) {
+  char line[160];
+
+  if (!profile_enabled()) {
+    screen_buffer_draw_string(game->screen, hud_len + 2, hud_y,
+                              "| Profiling off (make profile)");
+    return;
+  }
+
+  ProfStats frame;
+  profile_get_stats(PROF_FRAME, &frame);
+  snprintf(line, sizeof(line), "| Frame p50 %.2f p99 %.2f max %.2f ms",
+           frame.p50_ms, frame.p99_ms, frame.max_ms);
+  screen_buffer_draw_string(game->screen, hud_len + 2, hud_y, line);
+
+  int len = 0;
+  for (int phase = PROF_INPUT; phase < PROF_PHASE_COUNT; phase++) {
+    ProfStats stats;
+    profile_get_stats(phase, &stats);
+    len += snprintf(line + len, sizeof(line) - len, "%s %.2f/%.2f  ",
+                    profile_phase_name(phase), stats.p50_ms, stats.p99_ms);
+  }
+  screen_buffer_fill_row(game->screen, 0, hud_y + 1, game->screen->width,
+                         CELL_BLANK);
+  screen_buffer_draw_string(game->screen, 0, hud_y + 1, line);
 }
 
 void game_render(Game *game) {
-  screen_buffer_clear(game->screen);
+  PROF_BEGIN(PROF_RENDER);
 
-  int cam_x = (int)game->camera_x;
-  int cam_y = (int)game->camera_y;
+  // Draw between the last two ticks so motion stays smooth when the frame
+  // rate and tick rate drift apart
+  float alpha = game->render_alpha;
+  int cam_x = (int)lerp(game->prev_camera_x, game->camera_x, alpha);
+  int cam_y = (int)lerp(game->prev_camera_y, game->camera_y, alpha);
   int viewport_height = game->screen->height - 2; // Reserve bottom for HUD
 
-  // Render level
-  for (int y = 0; y < viewport_height && y + cam_y < LEVEL_HEIGHT; y++) {
-    for (int x = 0; x < game->screen->width && x + cam_x < LEVEL_WIDTH; x++) {
-      int world_x = x + cam_x;
-      int world_y = y + cam_y;
-      TileType tile = level_get_tile(&game->level, world_x, world_y);
-      if (tile != TILE_EMPTY) {
-        screen_buffer_draw_char(game->screen, x, y, tile);
-      }
-    }
+  // The level area follows the camera; pans become terminal scrolls
+  screen_buffer_set_scroll_region(game->screen, 0, viewport_height);
+  screen_buffer_set_origin(game->screen, cam_x, cam_y);
+
+  // Render level; every viewport cell is written, so no clear pass is needed
+  for (int y = 0; y < viewport_height; y++) {
+    render_level_row(game, y, cam_x, cam_y);
+  }
+
+  // Render entities in view
+  const EntityStore *es = &game->entities;
+  for (int i = 0; i < es->count; i++) {
+    int ex = (int)es->x[i] - cam_x;
+    int ey = (int)es->y[i] - cam_y;
+    if (ex >= 0 && ex < game->screen->width && ey >= 0 &&
+        ey < viewport_height)
+      screen_buffer_draw_cell(game->screen, ex, ey, entity_cells[es->type[i]]);
   }
 
   // Render player
-  int px = (int)game->player.x - cam_x;
-  int py = (int)game->player.y - cam_y;
+  int px = (int)lerp(game->prev_x, game->player.x, alpha) - cam_x;
+  int py = (int)lerp(game->prev_y, game->player.y, alpha) - cam_y;
   if (px >= 0 && px < game->screen->width && py >= 0 && py < viewport_height) {
-    char player_char = player_get_sprite(&game->player);
-    screen_buffer_draw_char(game->screen, px, py, player_char);
+    Cell player_cell = CELL_BLANK;
+    player_cell.ch = player_get_sprite(&game->player);
+    player_cell.attr = ATTR_BOLD;
+    screen_buffer_draw_cell(game->screen, px, py, player_cell);
   }
 
   // Render HUD at bottom
   int hud_y = game->screen->height - 2;
+  screen_buffer_fill_row(game->screen, 0, hud_y, game->screen->width,
+                         CELL_BLANK);
+  screen_buffer_fill_row(game->screen, 0, hud_y + 1, game->screen->width,
+                         CELL_BLANK);
   char hud[128];
-  snprintf(hud, sizeof(hud), "Lives: %d  Coins: %d  Pos: %.0f,%.0f",
-           game->player.lives, game->player.coins_collected, game->player.x,
-           game->player.y);
+  const LevelItems *items = &game->level.items;
+  int hud_len =
+      snprintf(hud, sizeof(hud), "Lives: %d  Coins: %ld/%ld  Pos: %.0f,%.0f",
+               game->player.lives, items->coins_collected, items->coins_total,
+               game->player.x, game->player.y);
   screen_buffer_draw_string(game->screen, 0, hud_y, hud);
 
-  char controls[] = "WASD/Arrows=Move SPACE=Jump P=Pause Q=Quit";
+  char controls[] =
+      "WASD/Arrows=Move SPACE=Jump P=Pause R=Restart T=Timing Q=Quit";
   screen_buffer_draw_string(game->screen, 0, hud_y + 1, controls);
 
+  if (game->show_profile) {
+    render_profile_overlay(game, hud_y, hud_len);
+  }
+
   // Show victory message
   if (game->victory) {
     int msg_y = game->screen->height / 2;
     char victory_msg[] = "*** VICTORY! Press Q to quit ***";
     int msg_x = (game->screen->width - strlen(victory_msg)) / 2;
     screen_buffer_draw_string(game->screen, msg_x, msg_y, victory_msg);
+
+    // End-of-level stats, straight from the collectible index
+    char stats_msg[64];
+    long percent = items->coins_total > 0 ? items->coins_collected * 100 /
+                                                items->coins_total
+                                          : 100;
+    snprintf(stats_msg, sizeof(stats_msg), "Coins %ld/%ld (%ld%%)",
+             items->coins_collected, items->coins_total, percent);
+    msg_x = (game->screen->width - strlen(stats_msg)) / 2;
+    screen_buffer_draw_string(game->screen, msg_x, msg_y + 1, stats_msg);
   }
 
   // Show pause message
@@ -277,86 +841,79 @@ void game_render(Game *game) {
     screen_buffer_draw_string(game->screen, msg_x, msg_y, death_msg);
   }
 
-  screen_buffer_render(game->screen);
-}
+  PROF_END(PROF_RENDER);
 
-void game_handle_input(Game *game) {
-  char c;
-  static bool space_held = false;
-  static bool up_held = false;
+  if (game->presenter) {
+    presenter_publish(game->presenter, game->screen);
+  } else {
+    screen_buffer_render(game->screen);
+  }
+}
 
-  while (read(STDIN_FILENO, &c, 1) == 1) {
-    // Quit
-    if (c == 'q' || c == 'Q' || c == 27) { // ESC
+// Apply one key event. Under the kitty keyboard protocol movement keys
+// are held until released and applied every tick; legacy terminals only
+// send presses, repeated by key autorepeat while the key is down.
+static void handle_key(Game *game, const KeyEvent *ev) {
+  bool pressed = ev->action == KEY_PRESS;
+  bool down = ev->action != KEY_RELEASE;
+  int key = ev->key;
+  if (key >= 'A' && key <= 'Z')
+    key += 'a' - 'A';
+
+  switch (key) {
+  case 'q':
+  case KEY_ESCAPE:
+    if (pressed)
       game->running = false;
-      return;
-    }
-
-    // Pause
-    if (c == 'p' || c == 'P') {
+    return;
+  case 'p':
+    if (pressed)
       game->paused = !game->paused;
-    }
+    return;
+  case 't': // Frame timing overlay
+    if (pressed)
+      game->show_profile = !game->show_profile;
+    return;
+  case 'r':
+    if (pressed)
+      game_restart(game);
+    return;
+  }
 
-    if (game->paused)
-      continue;
-
-    // Handle arrow keys (they come as escape sequences)
-    if (c == '\x1b') {
-      char seq[2];
-      if (read(STDIN_FILENO, &seq[0], 1) != 1)
-        continue;
-      if (read(STDIN_FILENO, &seq[1], 1) != 1)
-        continue;
-
-      if (seq[0] == '[') {
-        switch (seq[1]) {
-        case 'A': // Up arrow
-          if (!up_held) {
-            player_jump_press(&game->player);
-            up_held = true;
-          }
-          break;
-        case 'B': // Down arrow
-          break;
-        case 'C': // Right arrow
-          player_move_right(&game->player);
-          break;
-        case 'D': // Left arrow
-          player_move_left(&game->player);
-          break;
-        }
-      }
-    } else {
-      // Regular keys
-      switch (c) {
-      case 'a':
-      case 'A':
-        player_move_left(&game->player);
-        break;
-      case 'd':
-      case 'D':
-        player_move_right(&game->player);
-        break;
-      case 'w':
-      case 'W':
-        if (!up_held) {
-          player_jump_press(&game->player);
-          up_held = true;
-        }
-        break;
-      case ' ':
-        if (!space_held) {
-          player_jump_press(&game->player);
-          space_held = true;
-        }
-        break;
-      }
-    }
+  // Releases are applied while paused so no key stays held afterwards
+  switch (key) {
+  case 'a':
+  case KEY_LEFT:
+    game->held_left = down && game->key_releases;
+    if (down && !game->paused)
+      player_move_left(&game->player);
+    break;
+  case 'd':
+  case KEY_RIGHT:
+    game->held_right = down && game->key_releases;
+    if (down && !game->paused)
+      player_move_right(&game->player);
+    break;
+  case 'w':
+  case ' ':
+  case KEY_UP:
+    // A release cuts the jump short for variable jump height
+    if (!down)
+      player_jump_release(&game->player);
+    else if (pressed && !game->paused)
+      player_jump_press(&game->player);
+    break;
   }
+}
 
-  // Note: We can't detect key release in this simple input system,
-  // so variable jump height works by cutting the jump when space is no longer
-  // held In this implementation, we'll rely on the JUMP_CUT_MULTIPLIER applied
-  // immediately This is a limitation of non-blocking terminal input without a
-  // proper input library
+void game_handle_input(Game *game) {
+  KeyEvent ev;
+  bool more;
+
+  do {
+    more = input_read(&game->input);
+    while (game->running && input_next(&game->input, &ev)) {
+      handle_key(game, &ev);
+    }
+  } while (more && game->running);
 }
@@ -0,0 +1,216 @@
+#include "input.h"
+#include "terminal.h"
+#include <string.h>
+#include <time.h>
+
+#define INPUT_RING_MASK (INPUT_RING_SIZE - 1)
+
+// Parameters larger than this are clamped; no key code needs more
+#define INPUT_PARAM_MAX 0x10FFFF
+
+enum { INPUT_GROUND, INPUT_ESC, INPUT_CSI, INPUT_SS3 };
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void set_event(KeyEvent *ev, int key, KeyAction action, int mods) {
+  ev->key = key;
+  ev->action = action;
+  ev->mods = mods;
+}
+
+void input_init(InputParser *p) {
+  memset(p, 0, sizeof(*p));
+  p->state = INPUT_GROUND;
+}
+
+bool input_read(InputParser *p) {
+  bool full = false;
+
+  for (;;) {
+    unsigned used = p->tail - p->head;
+    unsigned space = INPUT_RING_SIZE - used;
+    if (space == 0) {
+      full = true;
+      break;
+    }
+
+    // Fill up to the wrap point; the next pass fills the start of the ring
+    unsigned offset = p->tail & INPUT_RING_MASK;
+    unsigned chunk = INPUT_RING_SIZE - offset;
+    if (chunk > space)
+      chunk = space;
+    int n = term_read_input((char *)p->ring + offset, (int)chunk);
+    if (n <= 0)
+      break;
+    p->tail += n;
+  }
+
+  // Scripted input delivers each frame's keys whole, so an ESC left at the
+  // end cannot be the start of a sequence still in flight
+  p->frame_complete = !full && term_input_fd() == -1;
+  return full;
+}
+
+int input_feed(InputParser *p, const char *data, int len) {
+  int n = 0;
+  while (n < len && p->tail - p->head < INPUT_RING_SIZE) {
+    p->ring[p->tail++ & INPUT_RING_MASK] = (unsigned char)data[n++];
+  }
+  p->frame_complete = false;
+  return n;
+}
+
+static void csi_reset(InputParser *p) {
+  memset(p->params, 0, sizeof(p->params));
+  p->param = 0;
+  p->sub = 0;
+  p->private_seq = false;
+  p->intermediate = false;
+}
+
+static int cursor_key(unsigned char final) {
+  switch (final) {
+  case 'A':
+    return KEY_UP;
+  case 'B':
+    return KEY_DOWN;
+  case 'C':
+    return KEY_RIGHT;
+  case 'D':
+    return KEY_LEFT;
+  case 'H':
+    return KEY_HOME;
+  case 'F':
+    return KEY_END;
+  }
+  return KEY_NONE;
+}
+
+// Turn a complete CSI sequence into a key event. Covers legacy cursor keys
+// (CSI 1;5A), CSI n~ editing keys and kitty CSI key;mods:event u.
+static bool csi_dispatch(InputParser *p, unsigned char final, KeyEvent *ev) {
+  // Replies to capability queries and unknown sequences are dropped
+  if (p->private_seq || p->intermediate)
+    return false;
+
+  int key = cursor_key(final);
+  if (final == 'u') {
+    key = p->params[0][0];
+  } else if (final == '~') {
+    int code = p->params[0][0];
+    key = code == 1 || code == 7 ? KEY_HOME
+          : code == 4 || code == 8 ? KEY_END
+                                   : KEY_NONE;
+  }
+  if (key == KEY_NONE)
+    return false;
+
+  // Modifiers are sent plus one; the event type is a sub-parameter
+  int mods = p->params[1][0] > 0 ? p->params[1][0] - 1 : 0;
+  KeyAction action = KEY_PRESS;
+  if (p->params[1][1] == 2)
+    action = KEY_REPEAT;
+  else if (p->params[1][1] == 3)
+    action = KEY_RELEASE;
+
+  set_event(ev, key, action, mods);
+  return true;
+}
+
+// Advance the state machine by one byte; true when it completes an event
+static bool parse_byte(InputParser *p, unsigned char c, KeyEvent *ev) {
+  switch (p->state) {
+  case INPUT_GROUND:
+    if (c == 0x1b) {
+      p->state = INPUT_ESC;
+      p->esc_ns = now_ns();
+      return false;
+    }
+    set_event(ev, c, KEY_PRESS, 0);
+    return true;
+
+  case INPUT_ESC:
+    if (c == '[') {
+      csi_reset(p);
+      p->state = INPUT_CSI;
+      return false;
+    }
+    if (c == 'O') {
+      p->state = INPUT_SS3;
+      return false;
+    }
+    if (c == 0x1b) {
+      // Escape pressed twice: report the first, keep waiting on the second
+      p->esc_ns = now_ns();
+      set_event(ev, KEY_ESCAPE, KEY_PRESS, 0);
+      return true;
+    }
+    p->state = INPUT_GROUND;
+    set_event(ev, c, KEY_PRESS, KEY_MOD_ALT);
+    return true;
+
+  case INPUT_SS3:
+    // Application cursor keys: ESC O A
+    p->state = INPUT_GROUND;
+    if (cursor_key(c) == KEY_NONE)
+      return false;
+    set_event(ev, cursor_key(c), KEY_PRESS, 0);
+    return true;
+
+  case INPUT_CSI:
+    if (c >= '0' && c <= '9') {
+      if (p->param < INPUT_MAX_PARAMS && p->sub < INPUT_MAX_SUBPARAMS) {
+        int *value = &p->params[p->param][p->sub];
+        *value = *value * 10 + (c - '0');
+        if (*value > INPUT_PARAM_MAX)
+          *value = INPUT_PARAM_MAX;
+      }
+    } else if (c == ';') {
+      p->param++;
+      p->sub = 0;
+    } else if (c == ':') {
+      p->sub++;
+    } else if (c >= 0x3c && c <= 0x3f) {
+      p->private_seq = true;
+    } else if (c >= 0x20 && c <= 0x2f) {
+      p->intermediate = true;
+    } else if (c >= 0x40 && c <= 0x7e) {
+      p->state = INPUT_GROUND;
+      return csi_dispatch(p, c, ev);
+    } else {
+      // Control byte inside a sequence: abandon it
+      p->state = INPUT_GROUND;
+      if (c == 0x1b) {
+        p->state = INPUT_ESC;
+        p->esc_ns = now_ns();
+      }
+    }
+    return false;
+  }
+  return false;
+}
+
+bool input_next(InputParser *p, KeyEvent *ev) {
+  while (p->head != p->tail) {
+    unsigned char c = p->ring[p->head++ & INPUT_RING_MASK];
+    if (parse_byte(p, c, ev))
+      return true;
+  }
+
+  // Nothing followed the ESC in time, so it was the Escape key itself
+  if (p->state == INPUT_ESC &&
+      (p->frame_complete || now_ns() - p->esc_ns >= INPUT_ESC_TIMEOUT_NS)) {
+    p->state = INPUT_GROUND;
+    set_event(ev, KEY_ESCAPE, KEY_PRESS, 0);
+    return true;
+  }
+  return false;
+}
+
+bool input_waiting(const InputParser *p) {
+  return p->state != INPUT_GROUND || p->head != p->tail;
+}
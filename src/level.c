@@ -1,20 +1,249 @@
 #include "level.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TILE_FLAGS_ENTRY(name, ch, flags) [ch] = flags,
+const unsigned char level_tile_flags[256] = {LEVEL_TILES(TILE_FLAGS_ENTRY)};
+
+// Bytes accepted as tiles in level files
+#define TILE_VALID_ENTRY(name, ch, flags) [ch] = true,
+static const bool tile_valid[256] = {LEVEL_TILES(TILE_VALID_ENTRY)};
+
+#define CHUNK_MASK (LEVEL_CHUNK_SIZE - 1)
+
+// Streaming hooks, defined with the loader at the end of this file
+static void stream_close(LevelStream *stream);
+static void stream_pin(LevelStream *stream, size_t c);
+
+// Read-only chunks that every all-empty and all-ground chunk points at
+static LevelChunk shared_empty;
+static LevelChunk shared_ground;
+static pthread_once_t shared_once = PTHREAD_ONCE_INIT;
+
+static void shared_chunks_init(void) {
+  memset(shared_empty.tiles, TILE_EMPTY, sizeof(shared_empty.tiles));
+  memset(shared_ground.tiles, TILE_GROUND, sizeof(shared_ground.tiles));
+  for (int y = 0; y < LEVEL_CHUNK_SIZE; y++) {
+    for (int l = 0; l < LEVEL_LAYERS; l++) {
+      shared_empty.layers[l][y] = 0;
+      shared_ground.layers[l][y] =
+          level_tile_flags[TILE_GROUND] & (1u << l) ? ~0u : 0;
+    }
+  }
+}
+
+static bool chunk_is_shared(const LevelChunk *chunk) {
+  return chunk == &shared_empty || chunk == &shared_ground;
+}
+
+// Recompute a chunk's collision layers from its tiles
+static void chunk_build_layers(LevelChunk *chunk) {
+  for (int y = 0; y < LEVEL_CHUNK_SIZE; y++) {
+    uint32_t bits[LEVEL_LAYERS] = {0};
+    for (int x = 0; x < LEVEL_CHUNK_SIZE; x++) {
+      unsigned flags = level_tile_flags[chunk->tiles[y][x]];
+      for (int l = 0; l < LEVEL_LAYERS; l++)
+        bits[l] |= (uint32_t)(flags >> l & 1) << x;
+    }
+    for (int l = 0; l < LEVEL_LAYERS; l++)
+      chunk->layers[l][y] = bits[l];
+  }
+}
+
+// Rebuild the layers of every private chunk after writing tiles directly
+static void build_layers(Level *level) {
+  size_t count = (size_t)level->chunks_x * level->chunks_y;
+  for (size_t i = 0; i < count; i++) {
+    if (!chunk_is_shared(level->chunks[i]))
+      chunk_build_layers(level->chunks[i]);
+  }
+}
+
+// Collectibles in one chunk; shared chunks hold none
+static LevelChunkItems chunk_count_items(const LevelChunk *chunk) {
+  LevelChunkItems items = {0, 0};
+  if (chunk_is_shared(chunk))
+    return items;
+  for (int y = 0; y < LEVEL_CHUNK_SIZE; y++) {
+    items.coins += __builtin_popcount(
+        chunk->layers[__builtin_ctz(TILE_FLAG_COLLECTIBLE)][y]);
+    for (int x = 0; x < LEVEL_CHUNK_SIZE; x++)
+      items.questions += chunk->tiles[y][x] == TILE_QUESTION;
+  }
+  return items;
+}
+
+// Add a chunk's collectibles to its summary and the level totals
+static void count_chunk_items(Level *level, size_t c) {
+  LevelChunkItems items = chunk_count_items(level->chunks[c]);
+  level->chunk_items[c] = items;
+  level->items.coins_total += items.coins;
+  level->items.coins_left += items.coins;
+  level->items.questions += items.questions;
+}
+
+// Build the collectible index of a freshly loaded level
+static void count_items(Level *level) {
+  size_t count = (size_t)level->chunks_x * level->chunks_y;
+  memset(&level->items, 0, sizeof(level->items));
+  for (size_t i = 0; i < count; i++)
+    count_chunk_items(level, i);
+}
+
+static int chunks_across(int tiles) {
+  return (tiles + LEVEL_CHUNK_SIZE - 1) / LEVEL_CHUNK_SIZE;
+}
+
+static LevelChunk **chunk_slot(Level *level, int x, int y) {
+  return &level->chunks[(size_t)(y >> LEVEL_CHUNK_SHIFT) * level->chunks_x +
+                        (x >> LEVEL_CHUNK_SHIFT)];
+}
+
+static unsigned char *tile_at(Level *level, int x, int y) {
+  return &(*chunk_slot(level, x, y))->tiles[y & CHUNK_MASK][x & CHUNK_MASK];
+}
+
+// Give a chunk private storage, copied from the shared chunk it pointed
+// at. Returns NULL if out of memory.
+static LevelChunk *chunk_own(Level *level, LevelChunk **slot) {
+  if (chunk_is_shared(*slot)) {
+    LevelChunk *chunk = malloc(sizeof(LevelChunk));
+    if (!chunk)
+      return NULL;
+    memcpy(chunk, *slot, sizeof(LevelChunk));
+    *slot = chunk;
+    level->chunks_owned++;
+  }
+  return *slot;
+}
+
+// Point private chunks that turned out all empty or all ground back at the
+// shared ones. Tiles past the level edge in edge chunks are ignored.
+static void share_uniform_chunks(Level *level) {
+  for (int cy = 0; cy < level->chunks_y; cy++) {
+    int h = level->height - cy * LEVEL_CHUNK_SIZE;
+    if (h > LEVEL_CHUNK_SIZE)
+      h = LEVEL_CHUNK_SIZE;
+    for (int cx = 0; cx < level->chunks_x; cx++) {
+      int w = level->width - cx * LEVEL_CHUNK_SIZE;
+      if (w > LEVEL_CHUNK_SIZE)
+        w = LEVEL_CHUNK_SIZE;
+      LevelChunk **slot = &level->chunks[(size_t)cy * level->chunks_x + cx];
+      if (chunk_is_shared(*slot))
+        continue;
+
+      unsigned char first = (*slot)->tiles[0][0];
+      LevelChunk *fill = first == TILE_GROUND ? &shared_ground : &shared_empty;
+      bool uniform = first == TILE_EMPTY || first == TILE_GROUND;
+      for (int y = 0; y < h && uniform; y++)
+        uniform = memcmp((*slot)->tiles[y], fill->tiles[y], w) == 0;
+      if (uniform) {
+        free(*slot);
+        *slot = fill;
+        level->chunks_owned--;
+      }
+    }
+  }
+}
+
+// Allocate empty storage for a width x height level: a directory whose
+// chunks all point at the shared empty chunk
+static int level_alloc(Level *level, int width, int height) {
+  pthread_once(&shared_once, shared_chunks_init);
+
+  int chunks_x = chunks_across(width);
+  int chunks_y = chunks_across(height);
+  size_t count = (size_t)chunks_x * chunks_y;
+  if (count > LEVEL_MAX_CHUNKS)
+    return -1;
+  level->chunks = malloc(count * sizeof(LevelChunk *));
+  level->chunk_items = calloc(count, sizeof(LevelChunkItems));
+  if (!level->chunks || !level->chunk_items) {
+    free(level->chunks);
+    free(level->chunk_items);
+    level->chunks = NULL;
+    return -1;
+  }
+  for (size_t i = 0; i < count; i++)
+    level->chunks[i] = &shared_empty;
+  level->chunks_x = chunks_x;
+  level->chunks_y = chunks_y;
+  level->chunks_owned = 0;
+  level->stream = NULL;
+  memset(&level->items, 0, sizeof(level->items));
+  level->edits = NULL;
+  level->edit_count = 0;
+  level->edit_capacity = 0;
+  level->width = width;
+  level->height = height;
+  level->spawn_x = width > 5 ? 5 : 0;
+  level->spawn_y = height > 10 ? height - 10 : 0;
+  level->number = 0;
+  level->name[0] = '\0';
+  return 0;
+}
+
+int level_create(Level *level, int width, int height) {
+  if (width < 1 || width > LEVEL_MAX_SIZE || height < 1 ||
+      height > LEVEL_MAX_SIZE)
+    return -1;
+  return level_alloc(level, width, height);
+}
+
+void level_compact(Level *level) { share_uniform_chunks(level); }
+
+void level_free(Level *level) {
+  if (level->stream) {
+    stream_close(level->stream);
+    level->stream = NULL;
+  }
+  if (level->chunks) {
+    size_t count = (size_t)level->chunks_x * level->chunks_y;
+    for (size_t i = 0; i < count; i++) {
+      if (!chunk_is_shared(level->chunks[i]))
+        free(level->chunks[i]);
+    }
+  }
+  free(level->chunks);
+  free(level->chunk_items);
+  level->chunks = NULL;
+  level->chunk_items = NULL;
+  level_commit(level);
+  level->chunks_x = 0;
+  level->chunks_y = 0;
+  level->chunks_owned = 0;
+  level->width = 0;
+  level->height = 0;
+}
+
+size_t level_memory_usage(const Level *level) {
+  return (size_t)level->chunks_x * level->chunks_y *
+             (sizeof(LevelChunk *) + sizeof(LevelChunkItems)) +
+         (size_t)level->chunks_owned * sizeof(LevelChunk) +
+         level->edit_capacity * sizeof(LevelEdit);
+}
 
 // Helper function to draw a horizontal line of tiles
 static void draw_hline(Level *level, int x1, int x2, int y, TileType tile) {
-  for (int x = x1; x <= x2 && x < LEVEL_WIDTH; x++) {
-    if (x >= 0 && y >= 0 && y < LEVEL_HEIGHT) {
-      level->tiles[y][x] = tile;
+  for (int x = x1; x <= x2 && x < level->width; x++) {
+    if (x >= 0 && y >= 0 && y < level->height) {
+      *tile_at(level, x, y) = tile;
     }
   }
 }
 
 // Helper function to draw a vertical line of tiles
 static void draw_vline(Level *level, int x, int y1, int y2, TileType tile) {
-  for (int y = y1; y <= y2 && y < LEVEL_HEIGHT; y++) {
-    if (x >= 0 && x < LEVEL_WIDTH && y >= 0) {
-      level->tiles[y][x] = tile;
+  for (int y = y1; y <= y2 && y < level->height; y++) {
+    if (x >= 0 && x < level->width && y >= 0) {
+      *tile_at(level, x, y) = tile;
     }
   }
 }
@@ -24,21 +253,31 @@ static void draw_rect(Level *level, int x1, int y1, int x2, int y2,
                       TileType tile) {
   for (int y = y1; y <= y2; y++) {
     for (int x = x1; x <= x2; x++) {
-      if (x >= 0 && x < LEVEL_WIDTH && y >= 0 && y < LEVEL_HEIGHT) {
-        level->tiles[y][x] = tile;
+      if (x >= 0 && x < level->width && y >= 0 && y < level->height) {
+        *tile_at(level, x, y) = tile;
       }
     }
   }
 }
 
-void level_init(Level *level) {
-  // Clear all tiles
-  memset(level->tiles, TILE_EMPTY, sizeof(level->tiles));
+int level_init(Level *level) {
+  if (level_alloc(level, LEVEL_WIDTH, LEVEL_HEIGHT) != 0)
+    return -1;
+  level->number = 1;
+
+  // The built-in level is a handful of chunks: give them all private
+  // storage up front so drawing cannot fail, then share what stays uniform
+  for (int i = 0; i < level->chunks_x * level->chunks_y; i++) {
+    if (!chunk_own(level, &level->chunks[i])) {
+      level_free(level);
+      return -1;
+    }
+  }
 
   // Create ground floor (bottom 2 rows)
-  for (int x = 0; x < LEVEL_WIDTH; x++) {
-    level->tiles[LEVEL_HEIGHT - 1][x] = TILE_GROUND;
-    level->tiles[LEVEL_HEIGHT - 2][x] = TILE_GROUND;
+  for (int x = 0; x < level->width; x++) {
+    *tile_at(level, x, LEVEL_HEIGHT - 1) = TILE_GROUND;
+    *tile_at(level, x, LEVEL_HEIGHT - 2) = TILE_GROUND;
   }
 
   // === SECTION 1: TUTORIAL (x: 0-40) ===
@@ -49,7 +288,7 @@ void level_init(Level *level) {
 
   // Coins above first platform (teach collection)
   for (int x = 11; x < 18; x++) {
-    level->tiles[LEVEL_HEIGHT - 7][x] = TILE_COIN;
+    *tile_at(level, x, LEVEL_HEIGHT - 7) = TILE_COIN;
   }
 
   // Second platform (higher - teach jumping)
@@ -57,7 +296,7 @@ void level_init(Level *level) {
 
   // More coins
   for (int x = 23; x < 30; x++) {
-    level->tiles[LEVEL_HEIGHT - 10][x] = TILE_COIN;
+    *tile_at(level, x, LEVEL_HEIGHT - 10) = TILE_COIN;
   }
 
   // === SECTION 2: PLATFORMING CHALLENGE (x: 40-120) ===
@@ -69,7 +308,7 @@ void level_init(Level *level) {
 
   // Coins on platforms
   for (int x = 46; x < 52; x++) {
-    level->tiles[LEVEL_HEIGHT - 7][x] = TILE_COIN;
+    *tile_at(level, x, LEVEL_HEIGHT - 7) = TILE_COIN;
   }
 
   // Vertical platforming section
@@ -80,7 +319,7 @@ void level_init(Level *level) {
 
   // Spikes to introduce hazard (can jump over or platform around)
   for (int x = 115; x < 125; x++) {
-    level->tiles[LEVEL_HEIGHT - 3][x] = TILE_SPIKE;
+    *tile_at(level, x, LEVEL_HEIGHT - 3) = TILE_SPIKE;
   }
 
   // Platform above spikes
@@ -97,7 +336,7 @@ void level_init(Level *level) {
 
   // Question blocks
   for (int x = 150; x < 156; x += 2) {
-    level->tiles[LEVEL_HEIGHT - 8][x] = TILE_QUESTION;
+    *tile_at(level, x, LEVEL_HEIGHT - 8) = TILE_QUESTION;
   }
 
   // Staircase
@@ -116,7 +355,7 @@ void level_init(Level *level) {
 
   // Final spike gauntlet
   for (int x = 178; x < 186; x++) {
-    level->tiles[LEVEL_HEIGHT - 3][x] = TILE_SPIKE;
+    *tile_at(level, x, LEVEL_HEIGHT - 3) = TILE_SPIKE;
   }
 
   // One-way platforms above
@@ -127,69 +366,1284 @@ void level_init(Level *level) {
   draw_hline(level, 188, 195, LEVEL_HEIGHT - 5, TILE_BRICK);
 
   // GOAL FLAG!
-  level->tiles[LEVEL_HEIGHT - 6][192] = TILE_GOAL;
-  level->tiles[LEVEL_HEIGHT - 7][192] = TILE_GOAL;
-  level->tiles[LEVEL_HEIGHT - 8][192] = TILE_GOAL;
+  *tile_at(level, 192, LEVEL_HEIGHT - 6) = TILE_GOAL;
+  *tile_at(level, 192, LEVEL_HEIGHT - 7) = TILE_GOAL;
+  *tile_at(level, 192, LEVEL_HEIGHT - 8) = TILE_GOAL;
 
   // Celebratory coins around flag
   for (int x = 189; x < 195; x++) {
-    level->tiles[LEVEL_HEIGHT - 9][x] = TILE_COIN;
+    *tile_at(level, x, LEVEL_HEIGHT - 9) = TILE_COIN;
   }
+
+  build_layers(level);
+  share_uniform_chunks(level);
+  count_items(level);
+  return 0;
 }
 
-bool level_is_solid(Level *level, int x, int y) {
-  if (x < 0 || x >= LEVEL_WIDTH || y < 0 || y >= LEVEL_HEIGHT) {
-    return false;
+// Flags of the tile at (x, y); none outside the level
+static unsigned flags_at(Level *level, int x, int y) {
+  if ((unsigned)x >= (unsigned)level->width ||
+      (unsigned)y >= (unsigned)level->height) {
+    return 0;
   }
+  return level_tile_flags[*tile_at(level, x, y)];
+}
 
-  TileType tile = level->tiles[y][x];
-  return (tile == TILE_GROUND || tile == TILE_BRICK || tile == TILE_PIPE_LEFT ||
-          tile == TILE_PIPE_RIGHT || tile == TILE_QUESTION);
+bool level_is_solid(Level *level, int x, int y) {
+  return flags_at(level, x, y) & TILE_FLAG_SOLID;
 }
 
 bool level_is_deadly(Level *level, int x, int y) {
-  if (x < 0 || x >= LEVEL_WIDTH || y < 0 || y >= LEVEL_HEIGHT) {
-    return false;
+  return flags_at(level, x, y) & TILE_FLAG_DEADLY;
+}
+
+bool level_is_platform(Level *level, int x, int y) {
+  return flags_at(level, x, y) & TILE_FLAG_ONE_WAY;
+}
+
+bool level_is_goal(Level *level, int x, int y) {
+  return flags_at(level, x, y) & TILE_FLAG_GOAL;
+}
+
+bool level_is_coin(Level *level, int x, int y) {
+  return flags_at(level, x, y) & TILE_FLAG_COLLECTIBLE;
+}
+
+void level_collect_coin(Level *level, int x, int y) {
+  if (level_is_coin(level, x, y) &&
+      level_set_tile(level, x, y, TILE_EMPTY) == 0) {
+    level->edits[level->edit_count - 1].collected = true;
+    level->items.coins_collected++;
   }
+}
 
-  return level->tiles[y][x] == TILE_SPIKE;
+TileType level_get_tile(Level *level, int x, int y) {
+  if (x < 0 || x >= level->width || y < 0 || y >= level->height) {
+    return TILE_EMPTY;
+  }
+  return (TileType)*tile_at(level, x, y);
 }
 
-bool level_is_platform(Level *level, int x, int y) {
-  if (x < 0 || x >= LEVEL_WIDTH || y < 0 || y >= LEVEL_HEIGHT) {
-    return false;
+// Store a tile and keep the layers and collectible index in step. Returns
+// -1 if a shared chunk could not be copied.
+static int tile_write(Level *level, int x, int y, unsigned char tile) {
+  LevelChunk **slot = chunk_slot(level, x, y);
+  LevelChunk *chunk = chunk_own(level, slot);
+  if (!chunk)
+    return -1;
+  size_t c = slot - level->chunks;
+  if (level->stream)
+    stream_pin(level->stream, c);
+
+  unsigned flags = level_tile_flags[tile];
+  unsigned char *cell = &chunk->tiles[y & CHUNK_MASK][x & CHUNK_MASK];
+  LevelChunkItems *items = &level->chunk_items[c];
+  int coins = ((flags & TILE_FLAG_COLLECTIBLE) != 0) -
+              ((level_tile_flags[*cell] & TILE_FLAG_COLLECTIBLE) != 0);
+  int questions = (tile == TILE_QUESTION) - (*cell == TILE_QUESTION);
+  items->coins += coins;
+  items->questions += questions;
+  level->items.coins_left += coins;
+  level->items.questions += questions;
+  *cell = tile;
+
+  uint32_t bit = 1u << (x & CHUNK_MASK);
+  for (int l = 0; l < LEVEL_LAYERS; l++) {
+    if (flags & (1u << l))
+      chunk->layers[l][y & CHUNK_MASK] |= bit;
+    else
+      chunk->layers[l][y & CHUNK_MASK] &= ~bit;
   }
+  return 0;
+}
 
-  return level->tiles[y][x] == TILE_PLATFORM;
+// Write a tile that differs from the current one and count any collectible
+// it adds to the level's total
+static int tile_replace(Level *level, int x, int y, unsigned char old,
+                        unsigned char tile) {
+  if (tile_write(level, x, y, tile) != 0)
+    return -1;
+  level->items.coins_total +=
+      (level_tile_flags[tile] & TILE_FLAG_COLLECTIBLE) &&
+      !(level_tile_flags[old] & TILE_FLAG_COLLECTIBLE);
+  return 0;
 }
 
-bool level_is_goal(Level *level, int x, int y) {
-  if (x < 0 || x >= LEVEL_WIDTH || y < 0 || y >= LEVEL_HEIGHT) {
+int level_set_tile(Level *level, int x, int y, TileType tile) {
+  if (x < 0 || x >= level->width || y < 0 || y >= level->height) {
+    return -1;
+  }
+  unsigned char old = *tile_at(level, x, y);
+  if (old == (unsigned char)tile)
+    return 0;
+
+  if (level->edit_count == level->edit_capacity) {
+    size_t capacity = level->edit_capacity ? level->edit_capacity * 2 : 64;
+    LevelEdit *edits = realloc(level->edits, capacity * sizeof(LevelEdit));
+    if (!edits)
+      return -1;
+    level->edits = edits;
+    level->edit_capacity = capacity;
+  }
+  if (tile_replace(level, x, y, old, (unsigned char)tile) != 0)
+    return -1;
+  level->edits[level->edit_count++] = (LevelEdit){x, y, old, false};
+  return 0;
+}
+
+int level_set_tile_raw(Level *level, int x, int y, TileType tile) {
+  if (x < 0 || x >= level->width || y < 0 || y >= level->height) {
+    return -1;
+  }
+  unsigned char old = *tile_at(level, x, y);
+  if (old == (unsigned char)tile)
+    return 0;
+  return tile_replace(level, x, y, old, (unsigned char)tile);
+}
+
+size_t level_checkpoint(const Level *level) { return level->edit_count; }
+
+void level_rollback(Level *level, size_t mark) {
+  while (level->edit_count > mark) {
+    const LevelEdit *edit = &level->edits[--level->edit_count];
+    unsigned char now = *tile_at(level, edit->x, edit->y);
+
+    // Only fails out of memory, re-copying a chunk compacted since the edit
+    tile_write(level, edit->x, edit->y, edit->tile);
+    if (edit->collected)
+      level->items.coins_collected--;
+    level->items.coins_total -=
+        (level_tile_flags[now] & TILE_FLAG_COLLECTIBLE) &&
+        !(level_tile_flags[edit->tile] & TILE_FLAG_COLLECTIBLE);
+  }
+}
+
+void level_commit(Level *level) {
+  free(level->edits);
+  level->edits = NULL;
+  level->edit_count = 0;
+  level->edit_capacity = 0;
+}
+
+// Union of the requested layers on one chunk row
+static uint32_t layer_bits(const LevelChunk *chunk, unsigned flags, int row) {
+  uint32_t bits = 0;
+  for (int l = 0; l < LEVEL_LAYERS; l++) {
+    if (flags & (1u << l))
+      bits |= chunk->layers[l][row];
+  }
+  return bits;
+}
+
+// Clip a column range to the level; false if nothing is left
+static bool clip_span(Level *level, int y, int *x0, int *x1) {
+  if (y < 0 || y >= level->height)
     return false;
+  if (*x0 < 0)
+    *x0 = 0;
+  if (*x1 >= level->width)
+    *x1 = level->width - 1;
+  return *x0 <= *x1;
+}
+
+int level_row_find_first(Level *level, unsigned flags, int y, int x0,
+                         int x1) {
+  if (!clip_span(level, y, &x0, &x1))
+    return -1;
+
+  LevelChunk **row = &level->chunks[(size_t)(y >> LEVEL_CHUNK_SHIFT) *
+                                    level->chunks_x];
+  int last = x1 >> LEVEL_CHUNK_SHIFT;
+  for (int cx = x0 >> LEVEL_CHUNK_SHIFT; cx <= last; cx++) {
+    uint32_t bits = layer_bits(row[cx], flags, y & CHUNK_MASK);
+    if (cx == x0 >> LEVEL_CHUNK_SHIFT)
+      bits &= ~0u << (x0 & CHUNK_MASK);
+    if (cx == last)
+      bits &= ~0u >> (CHUNK_MASK - (x1 & CHUNK_MASK));
+    if (bits)
+      return (cx << LEVEL_CHUNK_SHIFT) + __builtin_ctz(bits);
   }
+  return -1;
+}
+
+int level_row_find_last(Level *level, unsigned flags, int y, int x0, int x1) {
+  if (!clip_span(level, y, &x0, &x1))
+    return -1;
 
-  return level->tiles[y][x] == TILE_GOAL;
+  LevelChunk **row = &level->chunks[(size_t)(y >> LEVEL_CHUNK_SHIFT) *
+                                    level->chunks_x];
+  int first = x0 >> LEVEL_CHUNK_SHIFT;
+  for (int cx = x1 >> LEVEL_CHUNK_SHIFT; cx >= first; cx--) {
+    uint32_t bits = layer_bits(row[cx], flags, y & CHUNK_MASK);
+    if (cx == x1 >> LEVEL_CHUNK_SHIFT)
+      bits &= ~0u >> (CHUNK_MASK - (x1 & CHUNK_MASK));
+    if (cx == first)
+      bits &= ~0u << (x0 & CHUNK_MASK);
+    if (bits)
+      return (cx << LEVEL_CHUNK_SHIFT) + CHUNK_MASK - __builtin_clz(bits);
+  }
+  return -1;
 }
 
-bool level_is_coin(Level *level, int x, int y) {
-  if (x < 0 || x >= LEVEL_WIDTH || y < 0 || y >= LEVEL_HEIGHT) {
+TileQuery level_query_rect(Level *level, int x0, int y0, int x1, int y1) {
+  TileQuery q = {0, 0};
+  if (x1 < x0 || y1 < y0)
+    return q;
+
+  // Tiles outside the level are empty, which has no flags to share
+  q.all = ~0u;
+  if (x0 < 0 || y0 < 0 || x1 >= level->width || y1 >= level->height) {
+    q.all = 0;
+    x0 = x0 < 0 ? 0 : x0;
+    y0 = y0 < 0 ? 0 : y0;
+    x1 = x1 >= level->width ? level->width - 1 : x1;
+    y1 = y1 >= level->height ? level->height - 1 : y1;
+    if (x1 < x0 || y1 < y0)
+      return q;
+  }
+
+  // Whole spans within each chunk, no per-tile bounds checks
+  for (int y = y0; y <= y1; y++) {
+    for (int x = x0; x <= x1;) {
+      const unsigned char *row = tile_at(level, x, y);
+      int n = LEVEL_CHUNK_SIZE - (x & CHUNK_MASK);
+      if (n > x1 - x + 1)
+        n = x1 - x + 1;
+      for (int i = 0; i < n; i++) {
+        unsigned flags = level_tile_flags[row[i]];
+        q.any |= flags;
+        q.all &= flags;
+      }
+      x += n;
+    }
+  }
+  return q;
+}
+
+long level_count_coins(Level *level, int x0, int y0, int x1, int y1) {
+  x0 = x0 < 0 ? 0 : x0;
+  y0 = y0 < 0 ? 0 : y0;
+  x1 = x1 >= level->width ? level->width - 1 : x1;
+  y1 = y1 >= level->height ? level->height - 1 : y1;
+  if (x0 > x1 || y0 > y1)
+    return 0;
+
+  long coins = 0;
+  for (int cy = y0 >> LEVEL_CHUNK_SHIFT; cy <= y1 >> LEVEL_CHUNK_SHIFT;
+       cy++) {
+    int row0 = cy * LEVEL_CHUNK_SIZE;
+    int ry0 = y0 > row0 ? y0 : row0;
+    int ry1 = y1 < row0 + CHUNK_MASK ? y1 : row0 + CHUNK_MASK;
+    for (int cx = x0 >> LEVEL_CHUNK_SHIFT; cx <= x1 >> LEVEL_CHUNK_SHIFT;
+         cx++) {
+      size_t c = (size_t)cy * level->chunks_x + cx;
+      if (level->chunk_items[c].coins == 0)
+        continue;
+      // An evicted streamed chunk keeps its summary but reads as empty;
+      // like one never loaded, it counts nothing
+      int col0 = cx * LEVEL_CHUNK_SIZE;
+      if (!level_tile_loaded(level, col0, row0))
+        continue;
+      int rx0 = x0 > col0 ? x0 : col0;
+      int rx1 = x1 < col0 + CHUNK_MASK ? x1 : col0 + CHUNK_MASK;
+      if (rx0 == col0 && rx1 == col0 + CHUNK_MASK && ry0 == row0 &&
+          ry1 == row0 + CHUNK_MASK) {
+        coins += level->chunk_items[c].coins;
+        continue;
+      }
+
+      // Partly covered: count the collectible bits inside the rectangle
+      uint32_t mask = (~0u >> (CHUNK_MASK - (rx1 - col0))) &
+                      (~0u << (rx0 - col0));
+      for (int y = ry0; y <= ry1; y++) {
+        uint32_t bits = layer_bits(level->chunks[c], TILE_FLAG_COLLECTIBLE,
+                                   y & CHUNK_MASK);
+        coins += __builtin_popcount(bits & mask);
+      }
+    }
+  }
+  return coins;
+}
+
+const unsigned char *level_get_row_span(Level *level, int x, int y,
+                                        int *count) {
+  if (x < 0 || x >= level->width || y < 0 || y >= level->height) {
+    *count = 0;
+    return NULL;
+  }
+  int in_chunk = LEVEL_CHUNK_SIZE - (x & CHUNK_MASK);
+  *count = level->width - x < in_chunk ? level->width - x : in_chunk;
+  return tile_at(level, x, y);
+}
+
+// Apply one "KEY value" header line. Returns -1 for unknown keys or
+// malformed values.
+static int parse_header(Level *level, const char *line) {
+  int a, b;
+  if (sscanf(line, "LEVEL %d", &a) == 1) {
+    level->number = a;
+  } else if (sscanf(line, "WIDTH %d", &a) == 1) {
+    level->width = a;
+  } else if (sscanf(line, "HEIGHT %d", &a) == 1) {
+    level->height = a;
+  } else if (sscanf(line, "SPAWN %d %d", &a, &b) == 2) {
+    level->spawn_x = a;
+    level->spawn_y = b;
+  } else if (strncmp(line, "NAME ", 5) == 0) {
+    // Longer names are cut to fit
+    size_t len = strlen(line + 5);
+    if (len > sizeof(level->name) - 1)
+      len = sizeof(level->name) - 1;
+    snprintf(level->name, sizeof(level->name), "%.*s", (int)len, line + 5);
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+// Reject levels whose chunk directory would exceed LEVEL_MAX_CHUNKS
+static bool level_too_large(long width, long height, const char *name) {
+  if ((size_t)chunks_across(width) * chunks_across(height) <=
+      LEVEL_MAX_CHUNKS)
     return false;
+  fprintf(stderr, "%s: %ldx%ld level spans more than %d chunks\n", name,
+          width, height, LEVEL_MAX_CHUNKS);
+  return true;
+}
+
+// Copy a text row into the level a chunk at a time. Runs of sky are left
+// pointing at the shared empty chunk.
+static int copy_row(Level *level, int y, const char *row, size_t n) {
+  for (size_t x = 0; x < n;) {
+    size_t seg = LEVEL_CHUNK_SIZE - (x & CHUNK_MASK);
+    if (seg > n - x)
+      seg = n - x;
+
+    bool empty = true;
+    for (size_t i = 0; i < seg; i++)
+      empty &= row[x + i] == TILE_EMPTY;
+    if (!empty) {
+      LevelChunk *chunk = chunk_own(level, chunk_slot(level, (int)x, y));
+      if (!chunk)
+        return -1;
+      memcpy(&chunk->tiles[y & CHUNK_MASK][x & CHUNK_MASK], row + x, seg);
+    }
+    x += seg;
+  }
+  return 0;
+}
+
+int level_parse(Level *level, const char *data, size_t len, const char *name) {
+  const char *p = data;
+  const char *end = data + len;
+  int line = 0;
+
+  // Header: KEY value lines and # comments, ended by the first blank line
+  Level header = {0};
+  bool have_spawn = false;
+  int spawn_line = 0;
+  for (;;) {
+    if (p >= end) {
+      fprintf(stderr, "%s: missing blank line before level rows\n", name);
+      return -1;
+    }
+    const char *eol = memchr(p, '\n', end - p);
+    if (!eol)
+      eol = end;
+    size_t n = eol - p;
+    if (n > 0 && p[n - 1] == '\r')
+      n--;
+    line++;
+
+    char buf[128];
+    if (n == 0) {
+      p = eol < end ? eol + 1 : end;
+      break;
+    }
+    if (p[0] != '#') {
+      if (n >= sizeof(buf)) {
+        fprintf(stderr, "%s:%d: header line too long\n", name, line);
+        return -1;
+      }
+      memcpy(buf, p, n);
+      buf[n] = '\0';
+      if (parse_header(&header, buf) != 0) {
+        fprintf(stderr, "%s:%d: unknown header '%s'\n", name, line, buf);
+        return -1;
+      }
+      if (strncmp(buf, "SPAWN ", 6) == 0) {
+        have_spawn = true;
+        spawn_line = line;
+      }
+    }
+    p = eol < end ? eol + 1 : end;
+  }
+
+  if (header.width < 1 || header.width > LEVEL_MAX_SIZE ||
+      header.height < 1 || header.height > LEVEL_MAX_SIZE) {
+    fprintf(stderr, "%s: WIDTH and HEIGHT must be 1 to %d\n", name,
+            LEVEL_MAX_SIZE);
+    return -1;
+  }
+  if (level_too_large(header.width, header.height, name))
+    return -1;
+
+  Level parsed;
+  if (level_alloc(&parsed, header.width, header.height) != 0) {
+    fprintf(stderr, "%s: out of memory for %dx%d level\n", name,
+            header.width, header.height);
+    return -1;
+  }
+  parsed.number = header.number;
+  memcpy(parsed.name, header.name, sizeof(parsed.name));
+  // Without SPAWN the level keeps the default, which is always inside
+  if (have_spawn) {
+    if (header.spawn_x < 0 || header.spawn_x >= parsed.width ||
+        header.spawn_y < 0 || header.spawn_y >= parsed.height) {
+      fprintf(stderr, "%s:%d: SPAWN %d %d is outside the level\n", name,
+              spawn_line, header.spawn_x, header.spawn_y);
+      level_free(&parsed);
+      return -1;
+    }
+    parsed.spawn_x = header.spawn_x;
+    parsed.spawn_y = header.spawn_y;
   }
 
-  return level->tiles[y][x] == TILE_COIN;
+  // Rows: one line per tile row, copied straight into the level's chunks.
+  // Short rows and missing trailing rows are left empty.
+  for (int y = 0; p < end; y++) {
+    const char *eol = memchr(p, '\n', end - p);
+    if (!eol)
+      eol = end;
+    size_t n = eol - p;
+    if (n > 0 && p[n - 1] == '\r')
+      n--;
+    line++;
+
+    if (y >= parsed.height) {
+      if (n > 0) {
+        fprintf(stderr, "%s:%d: more than HEIGHT %d rows\n", name, line,
+                parsed.height);
+        level_free(&parsed);
+        return -1;
+      }
+    } else {
+      if (n > (size_t)parsed.width) {
+        fprintf(stderr, "%s:%d: row is %zu tiles, WIDTH is %d\n", name, line,
+                n, parsed.width);
+        level_free(&parsed);
+        return -1;
+      }
+
+      // Branch-free check of the whole row; find the culprit only on error
+      bool ok = true;
+      for (size_t i = 0; i < n; i++)
+        ok &= tile_valid[(unsigned char)p[i]];
+      if (!ok) {
+        size_t i = 0;
+        while (tile_valid[(unsigned char)p[i]])
+          i++;
+        fprintf(stderr, "%s:%d:%zu: invalid tile '%c'\n", name, line, i + 1,
+                p[i]);
+        level_free(&parsed);
+        return -1;
+      }
+      if (copy_row(&parsed, y, p, n) != 0) {
+        fprintf(stderr, "%s: out of memory for %dx%d level\n", name,
+                parsed.width, parsed.height);
+        level_free(&parsed);
+        return -1;
+      }
+    }
+    p = eol < end ? eol + 1 : end;
+  }
+
+  build_layers(&parsed);
+  share_uniform_chunks(&parsed);
+  count_items(&parsed);
+  *level = parsed;
+  return 0;
 }
 
-void level_collect_coin(Level *level, int x, int y) {
-  if (x >= 0 && x < LEVEL_WIDTH && y >= 0 && y < LEVEL_HEIGHT) {
-    if (level->tiles[y][x] == TILE_COIN) {
-      level->tiles[y][x] = TILE_EMPTY;
+/*
+ * Binary levels
+ *
+ * Little-endian header (LEVEL_BIN_HEADER bytes), the level name, a table
+ * of chunk_count + 1 offsets into the chunk data, then the chunks. Each
+ * chunk covers LEVEL_CHUNK_SIZE x LEVEL_CHUNK_SIZE tiles (clipped at the
+ * right and bottom edges), stored row-major as (count, tile) byte pairs,
+ * so any chunk decodes on its own. The checksum is a CRC-32 of the whole
+ * file with the checksum field zeroed.
+ */
+
+#define LEVEL_BIN_HEADER 36
+#define LEVEL_BIN_CHECKSUM_AT 28
+
+static uint32_t crc_table[256];
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char *data,
+                             size_t len) {
+  if (crc_table[1] == 0) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      crc_table[i] = c;
     }
   }
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++)
+    crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
 }
 
-TileType level_get_tile(Level *level, int x, int y) {
-  if (x < 0 || x >= LEVEL_WIDTH || y < 0 || y >= LEVEL_HEIGHT) {
-    return TILE_EMPTY;
+// CRC of a whole file, reading the checksum field as zero
+static uint32_t level_bin_crc(const unsigned char *data, size_t len) {
+  static const unsigned char zero[4] = {0};
+  uint32_t crc = crc32_update(0, data, LEVEL_BIN_CHECKSUM_AT);
+  crc = crc32_update(crc, zero, 4);
+  return crc32_update(crc, data + LEVEL_BIN_CHECKSUM_AT + 4,
+                      len - LEVEL_BIN_CHECKSUM_AT - 4);
+}
+
+static void put_u16(unsigned char *p, uint32_t v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+  put_u16(p, v & 0xffff);
+  put_u16(p + 2, v >> 16);
+}
+
+static uint32_t get_u16(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+  return get_u16(p) | get_u16(p + 2) << 16;
+}
+
+// Growable output buffer for the encoder
+typedef struct {
+  unsigned char *data;
+  size_t len;
+  size_t cap;
+} ByteBuffer;
+
+static int buffer_reserve(ByteBuffer *buf, size_t extra) {
+  if (buf->len + extra <= buf->cap)
+    return 0;
+  size_t cap = buf->cap ? buf->cap : 4096;
+  while (cap < buf->len + extra)
+    cap *= 2;
+  unsigned char *grown = realloc(buf->data, cap);
+  if (!grown)
+    return -1;
+  buf->data = grown;
+  buf->cap = cap;
+  return 0;
+}
+
+int level_encode(Level *level, unsigned char **out, size_t *out_len) {
+  int chunks_x = level->chunks_x;
+  size_t chunk_count = (size_t)chunks_x * level->chunks_y;
+  size_t name_len = strlen(level->name);
+  size_t table_at = LEVEL_BIN_HEADER + name_len;
+  size_t data_at = table_at + (chunk_count + 1) * 4;
+
+  ByteBuffer buf = {NULL, 0, 0};
+  if (buffer_reserve(&buf, data_at) != 0)
+    return -1;
+  memset(buf.data, 0, data_at);
+  memcpy(buf.data, LEVEL_BIN_MAGIC, 4);
+  put_u16(buf.data + 4, LEVEL_BIN_VERSION);
+  put_u16(buf.data + 6, LEVEL_CHUNK_SIZE);
+  put_u32(buf.data + 8, level->width);
+  put_u32(buf.data + 12, level->height);
+  put_u32(buf.data + 16, (uint32_t)level->spawn_x);
+  put_u32(buf.data + 20, (uint32_t)level->spawn_y);
+  put_u32(buf.data + 24, (uint32_t)level->number);
+  put_u16(buf.data + 32, name_len);
+  memcpy(buf.data + LEVEL_BIN_HEADER, level->name, name_len);
+  buf.len = data_at;
+
+  for (size_t c = 0; c < chunk_count; c++) {
+    put_u32(buf.data + table_at + c * 4, buf.len - data_at);
+
+    int x0 = (int)(c % chunks_x) * LEVEL_CHUNK_SIZE;
+    int y0 = (int)(c / chunks_x) * LEVEL_CHUNK_SIZE;
+    int w = level->width - x0 < LEVEL_CHUNK_SIZE ? level->width - x0
+                                                 : LEVEL_CHUNK_SIZE;
+    int h = level->height - y0 < LEVEL_CHUNK_SIZE ? level->height - y0
+                                                  : LEVEL_CHUNK_SIZE;
+
+    // At most one pair per tile
+    if (buffer_reserve(&buf, (size_t)w * h * 2) != 0) {
+      free(buf.data);
+      return -1;
+    }
+
+    // File chunks are the storage chunks; runs continue across their rows
+    const LevelChunk *chunk = level->chunks[c];
+    int run = 0;
+    unsigned char run_tile = 0;
+    for (int y = 0; y < h; y++) {
+      const unsigned char *row = chunk->tiles[y];
+      for (int x = 0; x < w; x++) {
+        if (run > 0 && (row[x] != run_tile || run == 255)) {
+          buf.data[buf.len++] = (unsigned char)run;
+          buf.data[buf.len++] = run_tile;
+          run = 0;
+        }
+        run_tile = row[x];
+        run++;
+      }
+    }
+    buf.data[buf.len++] = (unsigned char)run;
+    buf.data[buf.len++] = run_tile;
+  }
+  put_u32(buf.data + table_at + chunk_count * 4, buf.len - data_at);
+  put_u32(buf.data + LEVEL_BIN_CHECKSUM_AT, level_bin_crc(buf.data, buf.len));
+
+  *out = buf.data;
+  *out_len = buf.len;
+  return 0;
+}
+
+int level_save(Level *level, const char *path) {
+  unsigned char *data;
+  size_t len;
+  if (level_encode(level, &data, &len) != 0) {
+    fprintf(stderr, "%s: out of memory encoding level\n", path);
+    return -1;
+  }
+
+  FILE *fp = fopen(path, "wb");
+  if (!fp) {
+    perror(path);
+    free(data);
+    return -1;
+  }
+  size_t written = fwrite(data, 1, len, fp);
+  int result = (fclose(fp) == 0 && written == len) ? 0 : -1;
+  if (result != 0)
+    perror(path);
+  free(data);
+  return result;
+}
+
+// Expand one chunk's runs into *out: the shared chunk if the chunk is all
+// empty or all ground, else a newly allocated one. Returns -1 if the runs
+// do not exactly cover the chunk or contain an invalid tile, -2 if out of
+// memory. Touches no level state, so the streaming loader can use it.
+static int decode_chunk(const unsigned char *p, const unsigned char *end,
+                        int w, int h, LevelChunk **out) {
+  int total = w * h;
+  int pos = 0;
+  bool uniform = true;
+
+  // Validate first, noting whether the chunk is a single tile throughout
+  for (const unsigned char *run = p; run + 1 < end; run += 2) {
+    if (run[0] == 0 || run[0] > total - pos || !tile_valid[run[1]])
+      return -1;
+    uniform &= run[1] == p[1];
+    pos += run[0];
+  }
+  if ((end - p) % 2 != 0 || pos != total)
+    return -1;
+
+  if (uniform && (p[1] == TILE_EMPTY || p[1] == TILE_GROUND)) {
+    *out = p[1] == TILE_EMPTY ? &shared_empty : &shared_ground;
+    return 0;
+  }
+
+  LevelChunk *chunk = malloc(sizeof(LevelChunk));
+  if (!chunk)
+    return -2;
+  memcpy(chunk, &shared_empty, sizeof(LevelChunk));
+  for (pos = 0; p < end; p += 2) {
+    int count = p[0];
+    unsigned char tile = p[1];
+    if (tile == TILE_EMPTY) {
+      pos += count;
+      continue;
+    }
+    while (count > 0) {
+      int col = pos % w;
+      int seg = w - col < count ? w - col : count;
+      memset(&chunk->tiles[pos / w][col], tile, seg);
+      pos += seg;
+      count -= seg;
+    }
+  }
+  chunk_build_layers(chunk);
+  *out = chunk;
+  return 0;
+}
+
+// Size of chunk c, clipped at the right and bottom edges of the level
+static void chunk_extent(int width, int height, int chunks_x, size_t c,
+                         int *w, int *h) {
+  int x0 = (int)(c % chunks_x) * LEVEL_CHUNK_SIZE;
+  int y0 = (int)(c / chunks_x) * LEVEL_CHUNK_SIZE;
+  *w = width - x0 < LEVEL_CHUNK_SIZE ? width - x0 : LEVEL_CHUNK_SIZE;
+  *h = height - y0 < LEVEL_CHUNK_SIZE ? height - y0 : LEVEL_CHUNK_SIZE;
+}
+
+// Check a binary level header and allocate an empty level from it. data
+// holds the first len bytes of the file, which must cover the header and
+// the name. Sets *table_at to the offset of the chunk offset table.
+static int bin_level_alloc(Level *level, const unsigned char *data,
+                           size_t len, const char *name, size_t *table_at) {
+  if (len < LEVEL_BIN_HEADER || memcmp(data, LEVEL_BIN_MAGIC, 4) != 0) {
+    fprintf(stderr, "%s: not a binary level\n", name);
+    return -1;
+  }
+  if (get_u16(data + 4) != LEVEL_BIN_VERSION ||
+      get_u16(data + 6) != LEVEL_CHUNK_SIZE) {
+    fprintf(stderr, "%s: unsupported binary level version %u\n", name,
+            get_u16(data + 4));
+    return -1;
+  }
+
+  uint32_t width = get_u32(data + 8);
+  uint32_t height = get_u32(data + 12);
+  size_t name_len = get_u16(data + 32);
+  if (width < 1 || width > LEVEL_MAX_SIZE || height < 1 ||
+      height > LEVEL_MAX_SIZE || name_len >= LEVEL_NAME_MAX ||
+      LEVEL_BIN_HEADER + name_len > len) {
+    fprintf(stderr, "%s: bad level header\n", name);
+    return -1;
+  }
+  if (level_too_large(width, height, name))
+    return -1;
+
+  Level allocated;
+  if (level_alloc(&allocated, width, height) != 0) {
+    fprintf(stderr, "%s: out of memory for %ux%u level\n", name, width,
+            height);
+    return -1;
+  }
+  allocated.spawn_x = (int32_t)get_u32(data + 16);
+  allocated.spawn_y = (int32_t)get_u32(data + 20);
+  allocated.number = (int32_t)get_u32(data + 24);
+  memcpy(allocated.name, data + LEVEL_BIN_HEADER, name_len);
+  allocated.name[name_len] = '\0';
+  if (allocated.spawn_x < 0 || allocated.spawn_x >= allocated.width ||
+      allocated.spawn_y < 0 || allocated.spawn_y >= allocated.height) {
+    fprintf(stderr, "%s: spawn point outside the level\n", name);
+    level_free(&allocated);
+    return -1;
+  }
+
+  *level = allocated;
+  *table_at = LEVEL_BIN_HEADER + name_len;
+  return 0;
+}
+
+int level_decode(Level *level, const unsigned char *data, size_t len,
+                 const char *name) {
+  if (len < LEVEL_BIN_HEADER || memcmp(data, LEVEL_BIN_MAGIC, 4) != 0) {
+    fprintf(stderr, "%s: not a binary level\n", name);
+    return -1;
   }
-  return level->tiles[y][x];
+  if (get_u32(data + LEVEL_BIN_CHECKSUM_AT) != level_bin_crc(data, len)) {
+    fprintf(stderr, "%s: checksum mismatch\n", name);
+    return -1;
+  }
+
+  Level decoded;
+  size_t table_at;
+  if (bin_level_alloc(&decoded, data, len, name, &table_at) != 0)
+    return -1;
+
+  size_t chunk_count = (size_t)decoded.chunks_x * decoded.chunks_y;
+  size_t data_at = table_at + (chunk_count + 1) * 4;
+  if (data_at > len) {
+    fprintf(stderr, "%s: truncated chunk table\n", name);
+    level_free(&decoded);
+    return -1;
+  }
+
+  // File chunks decode straight into the matching storage chunks
+  const unsigned char *table = data + table_at;
+  for (size_t c = 0; c < chunk_count; c++) {
+    size_t start = get_u32(table + c * 4);
+    size_t stop = get_u32(table + c * 4 + 4);
+    int w, h;
+    chunk_extent(decoded.width, decoded.height, decoded.chunks_x, c, &w, &h);
+    int result = -1;
+    if (start <= stop && data_at + stop <= len)
+      result = decode_chunk(data + data_at + start, data + data_at + stop, w,
+                            h, &decoded.chunks[c]);
+    if (result != 0) {
+      if (result == -2)
+        fprintf(stderr, "%s: out of memory for %dx%d level\n", name,
+                decoded.width, decoded.height);
+      else
+        fprintf(stderr, "%s: corrupt chunk %zu\n", name, c);
+      level_free(&decoded);
+      return -1;
+    }
+    if (!chunk_is_shared(decoded.chunks[c]))
+      decoded.chunks_owned++;
+  }
+
+  count_items(&decoded);
+  *level = decoded;
+  return 0;
+}
+
+int level_load(Level *level, const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    perror(path);
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    fprintf(stderr, "%s: empty or unreadable level file\n", path);
+    close(fd);
+    return -1;
+  }
+
+  // Map the file and decode it in place: no copies, no per-line buffers
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+  posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+  int result;
+  if (st.st_size >= 4 && memcmp(data, LEVEL_BIN_MAGIC, 4) == 0)
+    result = level_decode(level, data, st.st_size, path);
+  else
+    result = level_parse(level, data, st.st_size, path);
+  munmap(data, st.st_size);
+  return result;
+}
+
+/*
+ * Streaming
+ *
+ * The main thread owns the directory and the per-chunk state; the loader
+ * thread only reads the file and decodes. They share two rings under one
+ * mutex: chunk indices to read, and decoded chunks to install. At most
+ * STREAM_QUEUE chunks are in flight, so neither ring can overflow.
+ */
+
+#define STREAM_QUEUE 64 // Power of two
+#define STREAM_QUEUE_MASK (STREAM_QUEUE - 1)
+
+// Chunks around the spawn point loaded before level_stream_open() returns
+#define STREAM_SPAWN_RADIUS_X 2
+#define STREAM_SPAWN_RADIUS_Y 1
+
+// Largest valid chunk: one (count, tile) pair per tile
+#define STREAM_CHUNK_MAX (LEVEL_CHUNK_SIZE * LEVEL_CHUNK_SIZE * 2)
+
+enum { STREAM_ABSENT, STREAM_QUEUED, STREAM_RESIDENT };
+#define STREAM_STATE_MASK 0x03
+#define STREAM_COUNTED 0x40 // In the collectible index since first load
+#define STREAM_PINNED 0x80  // Written to: never evicted
+
+typedef struct {
+  size_t index;
+  LevelChunk *chunk; // NULL if the chunk could not be read
+} StreamLoad;
+
+struct LevelStream {
+  // Fixed once open, read by both threads
+  int fd;
+  size_t file_size;
+  size_t table_at;
+  size_t data_at;
+  int width;
+  int height;
+  int chunks_x;
+
+  // Main thread only
+  unsigned char *state; // STREAM_* per chunk
+  uint32_t *last_used;  // Update in which each chunk was last wanted
+  uint32_t now;         // Updates so far
+  size_t *resident;     // Private chunks that can be evicted
+  size_t resident_count;
+  size_t resident_cap;
+  size_t budget; // Private chunks to keep beyond the ones in use
+  unsigned outstanding; // Requested and not yet installed
+  LevelStreamStats stats;
+
+  // Shared, under lock
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  bool stop;
+  size_t requests[STREAM_QUEUE];
+  unsigned request_head;
+  unsigned request_tail;
+  StreamLoad done[STREAM_QUEUE];
+  unsigned done_head;
+  unsigned done_tail;
+};
+
+// Read and decode chunk c. Returns 0, -1 if unreadable or corrupt, or -2
+// if out of memory.
+static int stream_read_chunk(const LevelStream *s, size_t c,
+                             LevelChunk **out) {
+  unsigned char offsets[8];
+  unsigned char data[STREAM_CHUNK_MAX];
+
+  if (pread(s->fd, offsets, sizeof(offsets), s->table_at + c * 4) !=
+      (ssize_t)sizeof(offsets))
+    return -1;
+  size_t start = get_u32(offsets);
+  size_t stop = get_u32(offsets + 4);
+  if (start > stop || stop - start > sizeof(data) ||
+      s->data_at + stop > s->file_size)
+    return -1;
+  ssize_t len = (ssize_t)(stop - start);
+  if (pread(s->fd, data, len, s->data_at + start) != len)
+    return -1;
+
+  int w, h;
+  chunk_extent(s->width, s->height, s->chunks_x, c, &w, &h);
+  return decode_chunk(data, data + len, w, h, out);
+}
+
+static void *stream_loader(void *arg) {
+  LevelStream *s = arg;
+
+  pthread_mutex_lock(&s->lock);
+  for (;;) {
+    while (!s->stop && s->request_head == s->request_tail)
+      pthread_cond_wait(&s->wake, &s->lock);
+    if (s->stop)
+      break;
+    size_t c = s->requests[s->request_head++ & STREAM_QUEUE_MASK];
+    pthread_mutex_unlock(&s->lock);
+
+    LevelChunk *chunk;
+    if (stream_read_chunk(s, c, &chunk) != 0)
+      chunk = NULL;
+
+    pthread_mutex_lock(&s->lock);
+    s->done[s->done_tail++ & STREAM_QUEUE_MASK] = (StreamLoad){c, chunk};
+  }
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+static void stream_pin(LevelStream *s, size_t c) {
+  s->state[c] |= STREAM_PINNED;
+}
+
+static void stream_close(LevelStream *s) {
+  pthread_mutex_lock(&s->lock);
+  s->stop = true;
+  pthread_cond_signal(&s->wake);
+  pthread_mutex_unlock(&s->lock);
+  pthread_join(s->thread, NULL);
+
+  // Loads finished after the last update were never installed
+  while (s->done_head != s->done_tail) {
+    LevelChunk *chunk = s->done[s->done_head++ & STREAM_QUEUE_MASK].chunk;
+    if (chunk && !chunk_is_shared(chunk))
+      free(chunk);
+  }
+  pthread_cond_destroy(&s->wake);
+  pthread_mutex_destroy(&s->lock);
+  close(s->fd);
+  free(s->state);
+  free(s->last_used);
+  free(s->resident);
+  free(s);
+}
+
+// Put a loaded chunk in its slot; chunk is NULL if it could not be read
+static void stream_install(Level *level, size_t c, LevelChunk *chunk) {
+  LevelStream *s = level->stream;
+
+  s->state[c] = (s->state[c] & ~STREAM_STATE_MASK) | STREAM_RESIDENT;
+  if (!chunk) {
+    s->stats.errors++;
+    return;
+  }
+
+  // Written to before it arrived: the written chunk wins, and was counted
+  // as it was written
+  if (level->chunks[c] != &shared_empty) {
+    s->state[c] |= STREAM_COUNTED;
+    if (!chunk_is_shared(chunk))
+      free(chunk);
+    s->stats.loaded++;
+    return;
+  }
+  if (chunk_is_shared(chunk)) {
+    level->chunks[c] = chunk;
+    s->stats.loaded++;
+    return;
+  }
+
+  if (s->resident_count == s->resident_cap) {
+    size_t cap = s->resident_cap ? s->resident_cap * 2 : 64;
+    size_t *resident = realloc(s->resident, cap * sizeof(size_t));
+    if (!resident) {
+      // Drop it for now; it is requested again while still wanted
+      free(chunk);
+      s->state[c] &= ~STREAM_STATE_MASK;
+      return;
+    }
+    s->resident = resident;
+    s->resident_cap = cap;
+  }
+  s->resident[s->resident_count++] = c;
+  level->chunks[c] = chunk;
+  level->chunks_owned++;
+  s->stats.loaded++;
+
+  // Reloads after eviction are unchanged: written chunks are never evicted
+  if (!(s->state[c] & STREAM_COUNTED)) {
+    s->state[c] |= STREAM_COUNTED;
+    count_chunk_items(level, c);
+  }
+}
+
+// Drop the least recently wanted chunks until within the budget. Chunks
+// wanted in this update and pinned chunks stay.
+static void stream_evict(Level *level) {
+  LevelStream *s = level->stream;
+
+  while (s->resident_count > s->budget) {
+    size_t victim = s->resident_count;
+    uint32_t oldest = s->now;
+    for (size_t i = 0; i < s->resident_count; i++) {
+      size_t c = s->resident[i];
+      if (!(s->state[c] & STREAM_PINNED) && s->last_used[c] < oldest) {
+        oldest = s->last_used[c];
+        victim = i;
+      }
+    }
+    if (victim == s->resident_count)
+      break;
+
+    size_t c = s->resident[victim];
+    s->resident[victim] = s->resident[--s->resident_count];
+    free(level->chunks[c]);
+    level->chunks[c] = &shared_empty;
+    level->chunks_owned--;
+    s->state[c] &= ~STREAM_STATE_MASK;
+    s->stats.evicted++;
+  }
+}
+
+void level_stream_update(Level *level, int x, int y, int width, int height,
+                         int lead) {
+  LevelStream *s = level->stream;
+  if (!s)
+    return;
+  s->now++;
+
+  StreamLoad loads[STREAM_QUEUE];
+  unsigned load_count = 0;
+  pthread_mutex_lock(&s->lock);
+  while (s->done_head != s->done_tail)
+    loads[load_count++] = s->done[s->done_head++ & STREAM_QUEUE_MASK];
+  pthread_mutex_unlock(&s->lock);
+  for (unsigned i = 0; i < load_count; i++) {
+    s->outstanding--;
+    stream_install(level, loads[i].index, loads[i].chunk);
+  }
+
+  // Wanted window in tiles, then in chunks
+  long x0 = (long)x - LEVEL_CHUNK_SIZE;
+  long x1 = (long)x + width - 1 + LEVEL_CHUNK_SIZE;
+  long y0 = (long)y - LEVEL_CHUNK_SIZE;
+  long y1 = (long)y + height - 1 + LEVEL_CHUNK_SIZE;
+  if (lead > 0)
+    x1 += lead;
+  else
+    x0 += lead;
+  x0 = x0 < 0 ? 0 : x0;
+  y0 = y0 < 0 ? 0 : y0;
+  x1 = x1 >= level->width ? level->width - 1 : x1;
+  y1 = y1 >= level->height ? level->height - 1 : y1;
+
+  size_t wanted[STREAM_QUEUE];
+  unsigned wanted_count = 0;
+  if (x0 <= x1 && y0 <= y1) {
+    int cx0 = (int)(x0 >> LEVEL_CHUNK_SHIFT);
+    int cx1 = (int)(x1 >> LEVEL_CHUNK_SHIFT);
+    int cy0 = (int)(y0 >> LEVEL_CHUNK_SHIFT);
+    int cy1 = (int)(y1 >> LEVEL_CHUNK_SHIFT);
+    long mid = (long)x + width / 2;
+    int center = (int)((mid < x0 ? x0 : mid > x1 ? x1 : mid) >>
+                       LEVEL_CHUNK_SHIFT);
+
+    // Columns outward from the view's centre, so the view loads first
+    for (int d = 0; center - d >= cx0 || center + d <= cx1; d++) {
+      for (int side = 0; side < (d ? 2 : 1); side++) {
+        int cx = side ? center - d : center + d;
+        if (cx < cx0 || cx > cx1)
+          continue;
+        for (int cy = cy0; cy <= cy1; cy++) {
+          size_t c = (size_t)cy * level->chunks_x + cx;
+          s->last_used[c] = s->now;
+          if ((s->state[c] & STREAM_STATE_MASK) == STREAM_ABSENT &&
+              s->outstanding + wanted_count < STREAM_QUEUE) {
+            s->state[c] = (s->state[c] & ~STREAM_STATE_MASK) | STREAM_QUEUED;
+            wanted[wanted_count++] = c;
+          }
+        }
+      }
+    }
+  }
+
+  if (wanted_count > 0) {
+    pthread_mutex_lock(&s->lock);
+    for (unsigned i = 0; i < wanted_count; i++)
+      s->requests[s->request_tail++ & STREAM_QUEUE_MASK] = wanted[i];
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    s->outstanding += wanted_count;
+  }
+
+  stream_evict(level);
+}
+
+void level_stream_get_stats(const Level *level, LevelStreamStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  if (level->stream) {
+    *stats = level->stream->stats;
+    stats->resident = level->stream->resident_count;
+  }
+}
+
+bool level_tile_loaded(const Level *level, int x, int y) {
+  if (!level->stream || x < 0 || x >= level->width || y < 0 ||
+      y >= level->height)
+    return true;
+  size_t c = (size_t)(y >> LEVEL_CHUNK_SHIFT) * level->chunks_x +
+             (x >> LEVEL_CHUNK_SHIFT);
+  return (level->stream->state[c] & STREAM_STATE_MASK) == STREAM_RESIDENT;
+}
+
+bool level_file_is_binary(const char *path) {
+  unsigned char magic[4];
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return false;
+  bool binary = read(fd, magic, sizeof(magic)) == (ssize_t)sizeof(magic) &&
+                memcmp(magic, LEVEL_BIN_MAGIC, 4) == 0;
+  close(fd);
+  return binary;
+}
+
+int level_stream_open(Level *level, const char *path, size_t budget) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    perror(path);
+    return -1;
+  }
+
+  struct stat st;
+  unsigned char header[LEVEL_BIN_HEADER + LEVEL_NAME_MAX];
+  ssize_t header_len = -1;
+  if (fstat(fd, &st) == 0)
+    header_len = pread(fd, header, sizeof(header), 0);
+  if (header_len < 0) {
+    perror(path);
+    close(fd);
+    return -1;
+  }
+
+  Level streamed;
+  size_t table_at;
+  if (bin_level_alloc(&streamed, header, header_len, path, &table_at) != 0) {
+    close(fd);
+    return -1;
+  }
+  size_t chunk_count = (size_t)streamed.chunks_x * streamed.chunks_y;
+  size_t data_at = table_at + (chunk_count + 1) * 4;
+  if (data_at > (size_t)st.st_size) {
+    fprintf(stderr, "%s: truncated chunk table\n", path);
+    level_free(&streamed);
+    close(fd);
+    return -1;
+  }
+
+  LevelStream *s = calloc(1, sizeof(LevelStream));
+  if (s) {
+    s->state = calloc(chunk_count, 1);
+    s->last_used = calloc(chunk_count, sizeof(uint32_t));
+  }
+  if (!s || !s->state || !s->last_used) {
+    fprintf(stderr, "%s: out of memory for %dx%d level\n", path,
+            streamed.width, streamed.height);
+    if (s) {
+      free(s->state);
+      free(s->last_used);
+      free(s);
+    }
+    level_free(&streamed);
+    close(fd);
+    return -1;
+  }
+  s->fd = fd;
+  s->file_size = st.st_size;
+  s->table_at = table_at;
+  s->data_at = data_at;
+  s->width = streamed.width;
+  s->height = streamed.height;
+  s->chunks_x = streamed.chunks_x;
+  s->budget = budget / sizeof(LevelChunk);
+  pthread_mutex_init(&s->lock, NULL);
+  pthread_cond_init(&s->wake, NULL);
+  if (pthread_create(&s->thread, NULL, stream_loader, s) != 0) {
+    fprintf(stderr, "%s: cannot start the chunk loader\n", path);
+    pthread_cond_destroy(&s->wake);
+    pthread_mutex_destroy(&s->lock);
+    free(s->state);
+    free(s->last_used);
+    free(s);
+    level_free(&streamed);
+    close(fd);
+    return -1;
+  }
+  streamed.stream = s;
+
+  // The player starts and respawns here, so these load now, must be valid
+  // and are never evicted
+  int scx = streamed.spawn_x >> LEVEL_CHUNK_SHIFT;
+  int scy = streamed.spawn_y >> LEVEL_CHUNK_SHIFT;
+  for (int cy = scy - STREAM_SPAWN_RADIUS_Y; cy <= scy + STREAM_SPAWN_RADIUS_Y;
+       cy++) {
+    for (int cx = scx - STREAM_SPAWN_RADIUS_X;
+         cx <= scx + STREAM_SPAWN_RADIUS_X; cx++) {
+      if (cx < 0 || cx >= streamed.chunks_x || cy < 0 ||
+          cy >= streamed.chunks_y)
+        continue;
+      size_t c = (size_t)cy * streamed.chunks_x + cx;
+      LevelChunk *chunk;
+      int result = stream_read_chunk(s, c, &chunk);
+      if (result != 0) {
+        if (result == -2)
+          fprintf(stderr, "%s: out of memory for %dx%d level\n", path,
+                  streamed.width, streamed.height);
+        else
+          fprintf(stderr, "%s: corrupt chunk %zu\n", path, c);
+        level_free(&streamed);
+        return -1;
+      }
+      stream_install(&streamed, c, chunk);
+      stream_pin(s, c);
+    }
+  }
+
+  *level = streamed;
+  return 0;
 }
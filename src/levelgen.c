@@ -0,0 +1,168 @@
+#include "levelgen.h"
+#include <stdbool.h>
+
+// Columns at each end of a tier kept flat, around the spawn and the goal
+#define GEN_SAFE_COLUMNS 12
+
+// Section widths in columns
+#define GEN_SECTION_MIN 6
+#define GEN_SECTION_MAX 16
+
+typedef enum {
+  GEN_PIT,
+  GEN_PLATFORM,
+  GEN_PIPE,
+  GEN_SPIKES,
+  GEN_COINS,
+  GEN_QUESTION,
+  GEN_FEATURE_COUNT
+} GenFeature;
+
+typedef struct {
+  Level *level;
+  uint64_t rng;
+  bool failed; // A tile could not be stored
+} Gen;
+
+// splitmix64: small, fast and the same on every platform
+static uint64_t gen_next(Gen *gen) {
+  uint64_t z = (gen->rng += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform integer from lo to hi inclusive
+static int gen_range(Gen *gen, int lo, int hi) {
+  return lo + (int)(gen_next(gen) % (uint64_t)(hi - lo + 1));
+}
+
+static bool gen_chance(Gen *gen, float p) {
+  return (gen_next(gen) >> 40) < (uint64_t)(p * (float)(1 << 24));
+}
+
+// Fill a rectangle, inclusive, skipping tiles outside the level
+static void gen_fill(Gen *gen, int x0, int y0, int x1, int y1,
+                     TileType tile) {
+  Level *level = gen->level;
+  for (int y = y0 < 0 ? 0 : y0; y <= y1 && y < level->height; y++) {
+    for (int x = x0 < 0 ? 0 : x0; x <= x1 && x < level->width; x++) {
+      if (level_set_tile_raw(level, x, y, tile) != 0)
+        gen->failed = true;
+    }
+  }
+}
+
+// Put one feature in columns x0 to x1 of the tier whose floor is row top
+static void gen_feature(Gen *gen, GenFeature feature, int x0, int x1,
+                        int top, bool ground) {
+  int width = x1 - x0 + 1;
+  int mid = x0 + width / 2;
+
+  switch (feature) {
+  case GEN_PIT: {
+    int w = gen_range(gen, 2, 4);
+    gen_fill(gen, mid - w / 2, top, mid - w / 2 + w - 1,
+             ground ? gen->level->height - 1 : top, TILE_EMPTY);
+    break;
+  }
+  case GEN_PLATFORM: {
+    int w = gen_range(gen, 3, width - 2);
+    int y = top - gen_range(gen, 3, 4);
+    TileType tile = gen_chance(gen, 0.5f) ? TILE_PLATFORM : TILE_BRICK;
+    gen_fill(gen, x0 + 1, y, x0 + w, y, tile);
+    if (gen_chance(gen, 0.5f))
+      gen_fill(gen, x0 + 2, y - 1, x0 + w - 1, y - 1, TILE_COIN);
+    break;
+  }
+  case GEN_PIPE: {
+    int h = gen_range(gen, 2, 3);
+    gen_fill(gen, mid, top - h, mid, top - 1, TILE_PIPE_LEFT);
+    gen_fill(gen, mid + 1, top - h, mid + 1, top - 1, TILE_PIPE_RIGHT);
+    break;
+  }
+  case GEN_SPIKES: {
+    int w = gen_range(gen, 2, 5 < width ? 5 : width);
+    gen_fill(gen, mid - w / 2, top - 1, mid - w / 2 + w - 1, top - 1,
+             TILE_SPIKE);
+    break;
+  }
+  case GEN_COINS: {
+    int w = gen_range(gen, 3, width < 8 ? width : 8);
+    int h = gen_range(gen, 2, 3);
+    gen_fill(gen, mid - w / 2, top - 1 - h, mid - w / 2 + w - 1, top - 2,
+             TILE_COIN);
+    break;
+  }
+  case GEN_QUESTION: {
+    int w = gen_range(gen, 1, 4);
+    gen_fill(gen, mid - w / 2, top - 4, mid - w / 2 + w - 1, top - 4,
+             TILE_QUESTION);
+    gen_fill(gen, mid - w / 2, top - 5, mid - w / 2 + w - 1, top - 5,
+             TILE_COIN);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void levelgen_defaults(LevelGenParams *params) {
+  params->width = LEVEL_WIDTH;
+  params->height = LEVEL_HEIGHT;
+  params->seed = 1;
+  params->density = 0.5f;
+}
+
+int level_generate(Level *level, const LevelGenParams *params) {
+  if (params->width < LEVELGEN_MIN_WIDTH ||
+      params->height < LEVELGEN_MIN_HEIGHT)
+    return -1;
+
+  Level generated;
+  if (level_create(&generated, params->width, params->height) != 0)
+    return -1;
+  Gen gen = {&generated, params->seed, false};
+  float density = params->density < 0.0f   ? 0.0f
+                  : params->density > 1.0f ? 1.0f
+                                           : params->density;
+
+  // Tiers from the bottom up: ground under the first, brick floors above
+  int tiers = params->height / LEVELGEN_TIER_HEIGHT;
+  if (tiers < 1)
+    tiers = 1;
+  int ground_top = params->height - 2;
+  for (int t = 0; t < tiers; t++) {
+    int top = ground_top - t * LEVELGEN_TIER_HEIGHT;
+    bool ground = t == 0;
+    gen_fill(&gen, 0, top, params->width - 1,
+             ground ? params->height - 1 : top,
+             ground ? TILE_GROUND : TILE_BRICK);
+
+    int x = GEN_SAFE_COLUMNS;
+    int end = params->width - GEN_SAFE_COLUMNS;
+    while (x + GEN_SECTION_MIN <= end) {
+      int x1 = x + gen_range(&gen, GEN_SECTION_MIN, GEN_SECTION_MAX) - 1;
+      if (x1 >= end)
+        x1 = end - 1;
+      if (gen_chance(&gen, density)) {
+        GenFeature feature = gen_range(&gen, 0, GEN_FEATURE_COUNT - 1);
+        gen_feature(&gen, feature, x, x1, top, ground);
+      }
+      x = x1 + 1;
+    }
+  }
+
+  gen_fill(&gen, params->width - GEN_SAFE_COLUMNS / 2, ground_top - 1,
+           params->width - GEN_SAFE_COLUMNS / 2, ground_top - 1, TILE_GOAL);
+  generated.spawn_x = 2;
+  generated.spawn_y = ground_top - 1;
+
+  if (gen.failed) {
+    level_free(&generated);
+    return -1;
+  }
+  level_compact(&generated);
+  *level = generated;
+  return 0;
+}
@@ -1,6 +1,10 @@
 #include "game.h"
+#include "levelgen.h"
+#include "profile.h"
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 static Game *g_game = NULL;
 
@@ -11,21 +15,243 @@ void signal_handler(int signum) {
   }
 }
 
-int main(void) {
+static void print_usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --level PATH       Play the level file at PATH\n"
+          "  --generate WxH     Play a generated W x H level\n"
+          "  --seed N           Seed for --generate (default 1)\n"
+          "  --entities N       Drop N enemies over the loaded level area\n"
+          "  --headless FRAMES  Run FRAMES frames without a terminal\n"
+          "  --output PATH      Write headless frames to PATH\n"
+          "  --script PATH      Read headless input from PATH, keys per line\n"
+          "  --trace PATH       Write a Chrome trace of frame phases\n"
+          "  --tick-rate HZ     Simulation ticks per second (default %d)\n",
+          prog, GAME_TICK_RATE);
+}
+
+// Summarize a headless run for benchmarks: level load (or generation) time
+// and per-phase frame latencies
+static void print_profile(double load_ms) {
+  printf("Level ready in %.2f ms\n", load_ms);
+  for (int phase = 0; phase < PROF_PHASE_COUNT; phase++) {
+    ProfStats stats;
+    profile_get_stats(phase, &stats);
+    printf("%-10s p50 %.3f  p99 %.3f  max %.3f ms\n",
+           profile_phase_name(phase), stats.p50_ms, stats.p99_ms,
+           stats.max_ms);
+  }
+}
+
+// True when every chunk of column x is loaded, so an entity dropped there
+// falls all the way down
+static bool column_loaded(const Level *level, int x) {
+  for (int y = 0; y < level->height; y += LEVEL_CHUNK_SIZE) {
+    if (!level_tile_loaded(level, x, y))
+      return false;
+  }
+  return true;
+}
+
+// Drop count enemies from the top of the level, evenly spaced and
+// alternating walkers and jumpers, e.g. to load benchmarks. Streamed levels
+// only have the chunks around the spawn point loaded, and entities over the
+// rest would wait for them, so they are spread over the loaded columns.
+static void spawn_entities(Game *game, int count) {
+  const Level *level = &game->level;
+  int first = level->spawn_x;
+  int last = level->spawn_x;
+  while (first > 0 && column_loaded(level, first - 1))
+    first--;
+  while (last < level->width - 1 && column_loaded(level, last + 1))
+    last++;
+
+  float spacing = (float)(last - first + 1) / count;
+  for (int i = 0; i < count; i++) {
+    EntityType type = i % 2 ? ENTITY_JUMPER : ENTITY_WALKER;
+    float x = first + (i + 0.5f) * spacing;
+    if (entity_spawn(&game->entities, type, x, 0.0f) < 0)
+      break;
+  }
+}
+
+// Read a whole file into a NUL-terminated string
+static char *read_file(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    perror(path);
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  char *data = malloc(size + 1);
+  if (data) {
+    size_t n = fread(data, 1, size, fp);
+    data[n] = '\0';
+  }
+  fclose(fp);
+  return data;
+}
+
+int main(int argc, char **argv) {
   Game game;
   g_game = &game;
 
+  int headless_frames = 0;
+  const char *output_path = NULL;
+  const char *script_path = NULL;
+  const char *trace_path = NULL;
+  const char *level_path = NULL;
+  int tick_rate = GAME_TICK_RATE;
+  int entities = 0;
+  LevelGenParams gen;
+  bool generate = false;
+  levelgen_defaults(&gen);
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+      level_path = argv[++i];
+    } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+      generate = true;
+      if (sscanf(argv[++i], "%dx%d", &gen.width, &gen.height) != 2) {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      gen.seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--entities") == 0 && i + 1 < argc) {
+      entities = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+      headless_frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      output_path = argv[++i];
+    } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+      script_path = argv[++i];
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+      tick_rate = atoi(argv[++i]);
+      if (tick_rate < 1 || tick_rate > 1000) {
+        fprintf(stderr, "--tick-rate must be 1 to 1000\n");
+        return 1;
+      }
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (generate && level_path) {
+    fprintf(stderr, "--generate and --level cannot be combined\n");
+    return 1;
+  }
+
+  // Build a generated level before taking over the terminal
+  Level generated;
+  uint64_t load_start = profile_now_ns();
+  if (generate && level_generate(&generated, &gen) != 0) {
+    fprintf(stderr, "Cannot generate a %dx%d level (at least %dx%d)\n",
+            gen.width, gen.height, LEVELGEN_MIN_WIDTH, LEVELGEN_MIN_HEIGHT);
+    return 1;
+  }
+  double load_ms = (profile_now_ns() - load_start) / 1e6;
+
+  if (trace_path) {
+    if (!profile_enabled()) {
+      fprintf(stderr, "Warning: built without profiling, trace will be "
+                      "empty (use make profile)\n");
+    }
+    profile_trace_start();
+  }
+
   // Set up signal handlers for clean exit
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
 
+  if (headless_frames > 0) {
+    char *script = NULL;
+    if (script_path && !(script = read_file(script_path))) {
+      return 1;
+    }
+
+    TermBackend backend = output_path ? TERM_BACKEND_FILE : TERM_BACKEND_NULL;
+    if (game_init_headless(&game, backend, output_path, 80, 24) != 0) {
+      fprintf(stderr, "Failed to initialize game\n");
+      if (generate)
+        level_free(&generated);
+      free(script);
+      return 1;
+    }
+    if (generate) {
+      game_set_level(&game, &generated);
+    } else if (level_path) {
+      load_start = profile_now_ns();
+      if (game_load_level(&game, level_path) != 0) {
+        game_cleanup(&game);
+        free(script);
+        return 1;
+      }
+      load_ms = (profile_now_ns() - load_start) / 1e6;
+    }
+    if (entities > 0)
+      spawn_entities(&game, entities);
+    game.tick = 1.0f / tick_rate;
+
+    term_set_input_script(script);
+    int frames = game_run_headless(&game, headless_frames);
+    int active = entity_count_active(&game.entities, &game.level);
+    int spawned = game.entities.count;
+    game_cleanup(&game);
+    free(script);
+
+    if (trace_path) {
+      profile_trace_write(trace_path);
+    }
+
+    printf("Ran %d frames\n", frames);
+    if (entities > 0)
+      printf("Entities: %d active of %d at the end\n", active, spawned);
+    if (profile_enabled())
+      print_profile(load_ms);
+    return 0;
+  }
+
+  // Check the level file before taking over the terminal
+  Level level;
+  if (level_path) {
+    int result = level_file_is_binary(level_path)
+                     ? level_stream_open(&level, level_path, 0)
+                     : level_load(&level, level_path);
+    if (result != 0)
+      return 1;
+    level_free(&level);
+  }
+
   if (game_init(&game) != 0) {
     fprintf(stderr, "Failed to initialize game\n");
+    if (generate)
+      level_free(&generated);
+    return 1;
+  }
+  if (generate)
+    game_set_level(&game, &generated);
+  if (level_path && game_load_level(&game, level_path) != 0) {
+    game_cleanup(&game);
     return 1;
   }
+  if (entities > 0)
+    spawn_entities(&game, entities);
+  game.tick = 1.0f / tick_rate;
 
   game_run(&game);
   game_cleanup(&game);
 
+  if (trace_path) {
+    profile_trace_write(trace_path);
+  }
+
   return 0;
 }
@@ -7,7 +7,7 @@
 #define JUMP_CUT_MULTIPLIER                                                    \
   0.5f // Multiply velocity by this when jump released early
 #define MAX_FALL_SPEED 20.0f
-#define FRICTION 0.85f
+#define FRICTION 0.85f // Ground speed kept per 1/60 s
 #define COYOTE_TIME 0.15f     // Can jump this long after leaving ground
 #define JUMP_BUFFER_TIME 0.1f // Can press jump this early before landing
 
@@ -34,8 +34,9 @@ void player_update(Player *player, float delta_time) {
   if (player->is_dead) {
     player->respawn_timer += delta_time;
     player->vel_x = 0.0f;
+    float prev_vel_y = player->vel_y;
     player->vel_y += GRAVITY * delta_time * 0.5f; // Slower fall when dead
-    player->y += player->vel_y * delta_time;
+    player->y += 0.5f * (prev_vel_y + player->vel_y) * delta_time;
     return;
   }
 
@@ -47,6 +48,7 @@ void player_update(Player *player, float delta_time) {
   player->anim_timer += delta_time;
 
   // Apply gravity
+  float prev_vel_y = player->vel_y;
   player->vel_y += GRAVITY * delta_time;
 
   // Cap fall speed
@@ -54,17 +56,24 @@ void player_update(Player *player, float delta_time) {
     player->vel_y = MAX_FALL_SPEED;
   }
 
-  // Apply friction when on ground
-  if (player->on_ground) {
-    player->vel_x *= FRICTION;
+  // Apply friction when on ground, as a decay over time so slides are the
+  // same length at any tick rate
+  float dx = player->vel_x * delta_time;
+  if (player->on_ground && player->vel_x != 0.0f && delta_time > 0.0f) {
+    float decay = powf(FRICTION, delta_time * 60.0f);
+    // Distance covered while the speed decays through the tick
+    dx = player->vel_x * delta_time * (decay - 1.0f) / logf(decay);
+    player->vel_x *= decay;
     if (fabsf(player->vel_x) < 0.1f) {
       player->vel_x = 0.0f;
     }
   }
 
-  // Update position
-  player->x += player->vel_x * delta_time;
-  player->y += player->vel_y * delta_time;
+  // Update position. Moving at the average of the old and new vertical
+  // speed is exact under constant gravity, so jump arcs do not depend on
+  // the tick rate either.
+  player->x += dx;
+  player->y += 0.5f * (prev_vel_y + player->vel_y) * delta_time;
 
   // Update animation state
   if (player->on_ground) {
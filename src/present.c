@@ -0,0 +1,164 @@
+#include "present.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Set in Presenter.middle while the slot holds a frame not yet presented
+#define PRESENT_FRESH 0x4
+#define PRESENT_INDEX 0x3
+
+// How often the output thread rechecks a backed-up terminal
+#define PRESENT_BACKLOG_WAIT_NS 2000000
+
+// Swap the newest published frame into the output thread's front slot.
+// Returns false if nothing new was published since the last call.
+static bool take_newest(Presenter *p) {
+  if (!(__atomic_load_n(&p->middle, __ATOMIC_ACQUIRE) & PRESENT_FRESH))
+    return false;
+
+  // Only the publisher sets PRESENT_FRESH, so the slot is still fresh here
+  int prev = __atomic_exchange_n(&p->middle, p->front, __ATOMIC_ACQ_REL);
+  p->front = prev & PRESENT_INDEX;
+  return true;
+}
+
+static void present_front(Presenter *p) {
+  PresentFrame *frame = &p->slots[p->front];
+  ScreenBuffer *sb = p->screen;
+
+  // Hand the frame's cells to the renderer and keep its old back buffer
+  Cell *cells = sb->buffer;
+  sb->buffer = frame->cells;
+  frame->cells = cells;
+
+  screen_buffer_set_scroll_region(sb, frame->scroll_top, frame->scroll_bottom);
+  screen_buffer_set_origin(sb, frame->origin_x, frame->origin_y);
+  screen_buffer_render(sb);
+  __atomic_add_fetch(&p->frames_presented, 1, __ATOMIC_RELAXED);
+}
+
+static void *output_thread(void *arg) {
+  Presenter *p = arg;
+  struct pollfd pfd = {p->wake_pipe[0], POLLIN, 0};
+  char drain[64];
+
+  while (__atomic_load_n(&p->running, __ATOMIC_ACQUIRE)) {
+    if (poll(&pfd, 1, 100) > 0) {
+      while (read(p->wake_pipe[0], drain, sizeof(drain)) > 0) {
+      }
+    }
+
+    // Let a backed-up terminal drain; frames published meanwhile replace
+    // each other and go out as one
+    while (term_output_pending() > TERM_OUTPUT_BACKLOG_LIMIT &&
+           __atomic_load_n(&p->running, __ATOMIC_ACQUIRE)) {
+      struct timespec wait = {0, PRESENT_BACKLOG_WAIT_NS};
+      nanosleep(&wait, NULL);
+    }
+
+    if (take_newest(p)) {
+      present_front(p);
+    }
+  }
+
+  // Show the final frame before the terminal is restored
+  if (take_newest(p)) {
+    present_front(p);
+  }
+  return NULL;
+}
+
+Presenter *presenter_create(int width, int height) {
+  Presenter *p = calloc(1, sizeof(Presenter));
+  if (!p)
+    return NULL;
+
+  p->screen = screen_buffer_create(width, height);
+  bool ok = p->screen != NULL;
+  for (int i = 0; i < 3; i++) {
+    p->slots[i].cells = malloc(sizeof(Cell) * width * height);
+    ok = ok && p->slots[i].cells != NULL;
+  }
+  p->wake_pipe[0] = p->wake_pipe[1] = -1;
+  ok = ok && pipe(p->wake_pipe) == 0;
+
+  if (ok) {
+    fcntl(p->wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(p->wake_pipe[1], F_SETFL, O_NONBLOCK);
+    p->back = 0;
+    p->middle = 1;
+    p->front = 2;
+    p->running = true;
+    ok = pthread_create(&p->thread, NULL, output_thread, p) == 0;
+    if (!ok)
+      p->running = false;
+  }
+
+  if (!ok) {
+    presenter_destroy(p);
+    return NULL;
+  }
+  return p;
+}
+
+void presenter_stop(Presenter *p) {
+  if (p->running) {
+    __atomic_store_n(&p->running, false, __ATOMIC_RELEASE);
+    if (write(p->wake_pipe[1], "", 1) < 0) {
+      // Pipe full: the thread is already due to wake up
+    }
+    pthread_join(p->thread, NULL);
+  }
+}
+
+void presenter_destroy(Presenter *p) {
+  if (!p)
+    return;
+
+  presenter_stop(p);
+
+  for (int i = 0; i < 2; i++) {
+    if (p->wake_pipe[i] != -1)
+      close(p->wake_pipe[i]);
+  }
+  for (int i = 0; i < 3; i++) {
+    free(p->slots[i].cells);
+  }
+  screen_buffer_free(p->screen);
+  free(p);
+}
+
+void presenter_publish(Presenter *p, ScreenBuffer *sb) {
+  PresentFrame *frame = &p->slots[p->back];
+
+  // Zero-copy: the finished cells move into the slot, the slot's stale
+  // cells become the simulation's next back buffer
+  Cell *cells = frame->cells;
+  frame->cells = sb->buffer;
+  sb->buffer = cells;
+
+  frame->origin_x = sb->origin_x;
+  frame->origin_y = sb->origin_y;
+  frame->scroll_top = sb->scroll_top;
+  frame->scroll_bottom = sb->scroll_bottom;
+
+  int prev = __atomic_exchange_n(&p->middle, p->back | PRESENT_FRESH,
+                                 __ATOMIC_ACQ_REL);
+  p->back = prev & PRESENT_INDEX;
+  p->frames_published++;
+  if (prev & PRESENT_FRESH) {
+    __atomic_add_fetch(&p->frames_dropped, 1, __ATOMIC_RELAXED);
+  }
+
+  // Wake the output thread
+  if (write(p->wake_pipe[1], "", 1) < 0) {
+    // Pipe full: a wakeup is already pending
+  }
+}
+
+void presenter_get_stats(Presenter *p, long *presented, long *dropped) {
+  *presented = __atomic_load_n(&p->frames_presented, __ATOMIC_RELAXED);
+  *dropped = __atomic_load_n(&p->frames_dropped, __ATOMIC_RELAXED);
+}
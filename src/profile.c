@@ -0,0 +1,188 @@
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Log-linear histogram: 8 linear sub-buckets per power of two, so any
+// percentile is within ~12% of the true value from 1 ns to minutes
+#define PROF_BUCKETS 512
+#define PROF_SUB_BITS 3
+
+// Trace events kept for --trace (about 12 minutes of frames)
+#define PROF_TRACE_MAX (256 * 1024)
+
+typedef struct {
+  long buckets[PROF_BUCKETS];
+  long count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+} ProfHistogram;
+
+typedef struct {
+  uint64_t start_ns;
+  uint32_t dur_ns;
+  uint8_t phase;
+} ProfEvent;
+
+static ProfHistogram histograms[PROF_PHASE_COUNT];
+
+static ProfEvent *trace_events = NULL;
+static long trace_count = 0; // Reserved slots, may exceed PROF_TRACE_MAX
+static uint64_t trace_origin_ns = 0;
+
+static const char *phase_names[PROF_PHASE_COUNT] = {
+    "frame", "input", "update", "collide", "entities", "render", "present"};
+
+bool profile_enabled(void) {
+#ifdef TARIO_PROFILE
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint64_t profile_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int bucket_index(uint64_t ns) {
+  if (ns < (1u << PROF_SUB_BITS))
+    return (int)ns;
+  int msb = 63 - __builtin_clzll(ns);
+  int sub = (int)(ns >> (msb - PROF_SUB_BITS)) & ((1 << PROF_SUB_BITS) - 1);
+  return (msb - PROF_SUB_BITS + 1) * (1 << PROF_SUB_BITS) + sub;
+}
+
+// Midpoint of a bucket's range in nanoseconds
+static double bucket_value(int index) {
+  int per_octave = 1 << PROF_SUB_BITS;
+  if (index < per_octave)
+    return index;
+  int shift = index / per_octave - 1;
+  double lower = (double)((uint64_t)(per_octave + index % per_octave) << shift);
+  return lower + (double)(1ULL << shift) / 2.0;
+}
+
+void profile_record(ProfPhase phase, uint64_t start_ns, uint64_t end_ns) {
+  ProfHistogram *h = &histograms[phase];
+  uint64_t ns = end_ns - start_ns;
+
+  // Each phase has a single writer thread; atomics keep HUD reads clean
+  __atomic_add_fetch(&h->buckets[bucket_index(ns)], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&h->total_ns, ns, __ATOMIC_RELAXED);
+  if (ns > __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED))
+    __atomic_store_n(&h->max_ns, ns, __ATOMIC_RELAXED);
+
+  ProfEvent *events = __atomic_load_n(&trace_events, __ATOMIC_ACQUIRE);
+  if (events) {
+    long slot = __atomic_fetch_add(&trace_count, 1, __ATOMIC_RELAXED);
+    if (slot < PROF_TRACE_MAX) {
+      events[slot].start_ns = start_ns;
+      events[slot].dur_ns = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+      events[slot].phase = (uint8_t)phase;
+    }
+  }
+}
+
+void profile_get_stats(ProfPhase phase, ProfStats *stats) {
+  ProfHistogram *h = &histograms[phase];
+  long count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+
+  stats->count = count;
+  stats->mean_ms = 0.0;
+  stats->p50_ms = 0.0;
+  stats->p99_ms = 0.0;
+  stats->max_ms = __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED) / 1e6;
+  if (count == 0)
+    return;
+
+  uint64_t total_ns = __atomic_load_n(&h->total_ns, __ATOMIC_RELAXED);
+  stats->mean_ms = total_ns / 1e6 / count;
+
+  long p50_rank = (count + 1) / 2;
+  long p99_rank = count - count / 100;
+  long seen = 0;
+  bool have_p50 = false;
+  for (int i = 0; i < PROF_BUCKETS; i++) {
+    seen += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+    if (!have_p50 && seen >= p50_rank) {
+      stats->p50_ms = bucket_value(i) / 1e6;
+      have_p50 = true;
+    }
+    if (seen >= p99_rank) {
+      stats->p99_ms = bucket_value(i) / 1e6;
+      break;
+    }
+  }
+
+  // Bucket midpoints can overshoot the largest sample seen
+  if (stats->p50_ms > stats->max_ms)
+    stats->p50_ms = stats->max_ms;
+  if (stats->p99_ms > stats->max_ms)
+    stats->p99_ms = stats->max_ms;
+}
+
+const char *profile_phase_name(ProfPhase phase) { return phase_names[phase]; }
+
+int profile_trace_start(void) {
+  ProfEvent *events = calloc(PROF_TRACE_MAX, sizeof(ProfEvent));
+  if (!events)
+    return -1;
+
+  trace_count = 0;
+  trace_origin_ns = profile_now_ns();
+  __atomic_store_n(&trace_events, events, __ATOMIC_RELEASE);
+  return 0;
+}
+
+int profile_trace_write(const char *path) {
+  ProfEvent *events =
+      __atomic_exchange_n(&trace_events, NULL, __ATOMIC_ACQ_REL);
+  if (!events)
+    return -1;
+
+  FILE *fp = fopen(path, "w");
+  if (!fp) {
+    perror(path);
+    free(events);
+    return -1;
+  }
+
+  long count = trace_count < PROF_TRACE_MAX ? trace_count : PROF_TRACE_MAX;
+  bool first = true;
+  fprintf(fp, "{\"traceEvents\":[");
+  for (long i = 0; i < count; i++) {
+    const ProfEvent *e = &events[i];
+    if (e->start_ns < trace_origin_ns)
+      continue; // Slot reserved but never filled
+    // Output is written by its own thread when one is running
+    int tid = e->phase == PROF_PRESENT ? 2 : 1;
+    fprintf(fp,
+            "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+            "\"pid\":1,\"tid\":%d}",
+            first ? "" : ",", phase_names[e->phase],
+            (e->start_ns - trace_origin_ns) / 1e3, e->dur_ns / 1e3, tid);
+    first = false;
+  }
+  fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  int result = ferror(fp) ? -1 : 0;
+  fclose(fp);
+  free(events);
+  return result;
+}
+
+void profile_reset(void) {
+  for (int i = 0; i < PROF_PHASE_COUNT; i++) {
+    ProfHistogram *h = &histograms[i];
+    for (int b = 0; b < PROF_BUCKETS; b++)
+      h->buckets[b] = 0;
+    h->count = 0;
+    h->total_ns = 0;
+    h->max_ns = 0;
+  }
+  trace_count = 0;
+}
@@ -1,8 +1,30 @@
 #include "render.h"
+#include "profile.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Unchanged cells shorter than this between two changed runs are resent
+// rather than skipped: a cursor move costs about as many bytes.
+#define RENDER_RUN_GAP 6
+
+// Approximate byte costs used to decide whether a terminal scroll beats
+// repainting: a cursor move, an SGR change, SU/SD with scroll margins, and a
+// cursor move plus ICH/DCH for one row
+#define RENDER_CURSOR_COST 7
+#define RENDER_SGR_COST 6
+#define SCROLL_REGION_COST 16
+#define SCROLL_ROW_COST 10
+
+// Glyphs are staged here between SGR changes before going to term_write()
+#define RENDER_SPAN_MAX 256
+
+// The SIMD blit moves cells as 32-bit lanes
+typedef char cell_size_check[sizeof(Cell) == 4 ? 1 : -1];
 
 ScreenBuffer *screen_buffer_create(int width, int height) {
   ScreenBuffer *sb = malloc(sizeof(ScreenBuffer));
@@ -11,31 +33,101 @@ ScreenBuffer *screen_buffer_create(int width, int height) {
 
   sb->width = width;
   sb->height = height;
-  sb->buffer = malloc(width * height);
+  sb->buffer = malloc(sizeof(Cell) * width * height);
+  sb->front = malloc(sizeof(Cell) * width * height);
 
-  if (!sb->buffer) {
+  if (!sb->buffer || !sb->front) {
+    free(sb->buffer);
+    free(sb->front);
     free(sb);
     return NULL;
   }
 
+  sb->scroll_enabled = term_caps()->scroll_regions;
+  sb->scroll_top = 0;
+  sb->scroll_bottom = 0;
+  sb->origin_x = 0;
+  sb->origin_y = 0;
+
   screen_buffer_clear(sb);
+  screen_buffer_invalidate(sb);
   return sb;
 }
 
 void screen_buffer_free(ScreenBuffer *sb) {
   if (sb) {
     free(sb->buffer);
+    free(sb->front);
     free(sb);
   }
 }
 
 void screen_buffer_clear(ScreenBuffer *sb) {
-  memset(sb->buffer, ' ', sb->width * sb->height);
+  int count = sb->width * sb->height;
+  for (int i = 0; i < count; i++) {
+    sb->buffer[i] = CELL_BLANK;
+  }
 }
 
 void screen_buffer_draw_char(ScreenBuffer *sb, int x, int y, char c) {
+  Cell cell = CELL_BLANK;
+  cell.ch = c;
+  screen_buffer_draw_cell(sb, x, y, cell);
+}
+
+void screen_buffer_draw_cell(ScreenBuffer *sb, int x, int y, Cell cell) {
   if (x >= 0 && x < sb->width && y >= 0 && y < sb->height) {
-    sb->buffer[y * sb->width + x] = c;
+    sb->buffer[y * sb->width + x] = cell;
+  }
+}
+
+void screen_buffer_fill_row(ScreenBuffer *sb, int x, int y, int count,
+                            Cell cell) {
+  if (y < 0 || y >= sb->height)
+    return;
+  if (x < 0) {
+    count += x;
+    x = 0;
+  }
+  if (x + count > sb->width)
+    count = sb->width - x;
+
+  Cell *dst = &sb->buffer[y * sb->width + x];
+  for (int i = 0; i < count; i++) {
+    dst[i] = cell;
+  }
+}
+
+void screen_buffer_blit_row(ScreenBuffer *sb, int x, int y,
+                            const unsigned char *tiles, int count,
+                            const Cell *lut) {
+  if (y < 0 || y >= sb->height)
+    return;
+  if (x < 0) {
+    tiles -= x;
+    count += x;
+    x = 0;
+  }
+  if (x + count > sb->width)
+    count = sb->width - x;
+  if (count <= 0)
+    return;
+
+  Cell *dst = &sb->buffer[y * sb->width + x];
+  int i = 0;
+
+#if defined(__AVX2__)
+  // Widen 8 tile bytes to 32-bit indices and gather their cells at once
+  for (; i + 8 <= count; i += 8) {
+    __m128i bytes = _mm_loadl_epi64((const __m128i *)(tiles + i));
+    __m256i index = _mm256_cvtepu8_epi32(bytes);
+    __m256i cells = _mm256_i32gather_epi32((const int *)lut, index, 4);
+    _mm256_storeu_si256((__m256i *)(dst + i), cells);
+  }
+#endif
+
+  for (; i < count; i++) {
+    dst[i] = lut[tiles[i]];
   }
 }
 
@@ -48,15 +140,246 @@ void screen_buffer_draw_string(ScreenBuffer *sb, int x, int y,
   }
 }
 
-void screen_buffer_render(ScreenBuffer *sb) {
+void screen_buffer_set_scroll_region(ScreenBuffer *sb, int top, int bottom) {
+  sb->scroll_top = top < 0 ? 0 : top;
+  sb->scroll_bottom = bottom > sb->height ? sb->height : bottom;
+}
+
+void screen_buffer_set_origin(ScreenBuffer *sb, int x, int y) {
+  sb->origin_x = x;
+  sb->origin_y = y;
+}
+
+void screen_buffer_invalidate(ScreenBuffer *sb) {
+  sb->full_redraw = true;
+  sb->style = -1;
+}
+
+static int cell_style(const Cell *cell) {
+  return (cell->attr & 0xF) << 8 | (cell->bg & 0xF) << 4 | (cell->fg & 0xF);
+}
+
+static bool cell_equal(const Cell *a, const Cell *b) {
+  return a->ch == b->ch && a->fg == b->fg && a->bg == b->bg &&
+         a->attr == b->attr;
+}
+
+// Send a run of cells, switching SGR style only where adjacent cells differ
+static void emit_cells(ScreenBuffer *sb, const Cell *cells, int count) {
+  char span[RENDER_SPAN_MAX];
+  int len = 0;
+
+  for (int i = 0; i < count; i++) {
+    int style = cell_style(&cells[i]);
+    if (style != sb->style || len == RENDER_SPAN_MAX) {
+      term_write(span, len);
+      len = 0;
+      if (style != sb->style) {
+        term_set_style(cells[i].fg, cells[i].bg, cells[i].attr);
+        sb->style = style;
+      }
+    }
+    span[len++] = cells[i].ch;
+  }
+  term_write(span, len);
+}
+
+// Estimated bytes to repaint back over front shifted left by dx (front[x +
+// dx]); cells shifted in from outside the row count as blank. Each changed
+// cell costs its glyph, plus a cursor move when a run starts and an SGR
+// sequence when its style differs from the cell before it.
+static int row_cost(const Cell *back, const Cell *front, int width, int dx) {
+  const Cell blank = CELL_BLANK;
+  int cost = 0;
+  bool in_run = false;
+  for (int x = 0; x < width; x++) {
+    int src = x + dx;
+    const Cell *old = (src >= 0 && src < width) ? &front[src] : &blank;
+    if (cell_equal(&back[x], old)) {
+      in_run = false;
+      continue;
+    }
+    cost++;
+    if (!in_run)
+      cost += RENDER_CURSOR_COST;
+    if (x == 0 || cell_style(&back[x]) != cell_style(&back[x - 1]))
+      cost += RENDER_SGR_COST;
+    in_run = true;
+  }
+  return cost;
+}
+
+// Estimated bytes to repaint the scroll region if the terminal shifted it
+// up by dy
+static int region_cost(ScreenBuffer *sb, int dy) {
+  int cost = 0;
+  for (int y = sb->scroll_top; y < sb->scroll_bottom; y++) {
+    const Cell *back = &sb->buffer[y * sb->width];
+    int src = y + dy;
+    if (src >= sb->scroll_top && src < sb->scroll_bottom) {
+      cost += row_cost(back, &sb->front[src * sb->width], sb->width, 0);
+    } else {
+      // Exposed row: compare against all blanks
+      cost += row_cost(back, back, sb->width, sb->width);
+    }
+  }
+  return cost;
+}
+
+// Exposed cells are filled by the terminal in the current background, so
+// switch to the default style first
+static void use_blank_style(ScreenBuffer *sb) {
+  const Cell blank = CELL_BLANK;
+  int style = cell_style(&blank);
+  if (sb->style != style) {
+    term_set_style(blank.fg, blank.bg, blank.attr);
+    sb->style = style;
+  }
+}
+
+static void scroll_region_vertical(ScreenBuffer *sb, int dy) {
+  int top = sb->scroll_top;
+  int rows = sb->scroll_bottom - top;
+  int n = dy > 0 ? dy : -dy;
+
+  use_blank_style(sb);
+  term_set_scroll_region(top, sb->scroll_bottom);
+  if (dy > 0) {
+    term_scroll_up(n);
+  } else {
+    term_scroll_down(n);
+  }
+  term_reset_scroll_region();
+
+  // Mirror the scroll in the front buffer
+  Cell *region = &sb->front[top * sb->width];
+  Cell *exposed;
+  if (dy > 0) {
+    memmove(region, region + n * sb->width,
+            sizeof(Cell) * (rows - n) * sb->width);
+    exposed = region + (rows - n) * sb->width;
+  } else {
+    memmove(region + n * sb->width, region,
+            sizeof(Cell) * (rows - n) * sb->width);
+    exposed = region;
+  }
+  for (int i = 0; i < n * sb->width; i++) {
+    exposed[i] = CELL_BLANK;
+  }
+}
+
+static void scroll_row_horizontal(ScreenBuffer *sb, int y, int dx) {
+  Cell *front = &sb->front[y * sb->width];
+  int n = dx > 0 ? dx : -dx;
+
+  use_blank_style(sb);
+  term_move_cursor(0, y);
+  if (dx > 0) {
+    term_delete_chars(n);
+    memmove(front, front + n, sizeof(Cell) * (sb->width - n));
+    for (int x = sb->width - n; x < sb->width; x++)
+      front[x] = CELL_BLANK;
+  } else {
+    term_insert_chars(n);
+    memmove(front + n, front, sizeof(Cell) * (sb->width - n));
+    for (int x = 0; x < n; x++)
+      front[x] = CELL_BLANK;
+  }
+}
+
+// Turn a camera pan since the last frame into terminal scrolls, leaving
+// only the newly exposed strip and moved sprites for the diff pass
+static void apply_camera_scroll(ScreenBuffer *sb) {
+  int dx = sb->origin_x - sb->front_origin_x;
+  int dy = sb->origin_y - sb->front_origin_y;
+  int rows = sb->scroll_bottom - sb->scroll_top;
+
+  sb->front_origin_x = sb->origin_x;
+  sb->front_origin_y = sb->origin_y;
+  if (!sb->scroll_enabled || rows <= 0)
+    return;
+
+  if (dy != 0 && dy > -rows && dy < rows &&
+      region_cost(sb, dy) + SCROLL_REGION_COST < region_cost(sb, 0)) {
+    scroll_region_vertical(sb, dy);
+  }
+
+  if (dx != 0 && dx > -sb->width && dx < sb->width) {
+    // Rows decide independently: empty sky gains nothing from a shift
+    for (int y = sb->scroll_top; y < sb->scroll_bottom; y++) {
+      const Cell *back = &sb->buffer[y * sb->width];
+      const Cell *front = &sb->front[y * sb->width];
+      if (row_cost(back, front, sb->width, dx) + SCROLL_ROW_COST <
+          row_cost(back, front, sb->width, 0)) {
+        scroll_row_horizontal(sb, y, dx);
+      }
+    }
+  }
+}
+
+static void render_full(ScreenBuffer *sb) {
   // Move cursor to home position
   term_move_cursor(0, 0);
 
   // Render buffer line by line
   for (int y = 0; y < sb->height; y++) {
-    write(STDOUT_FILENO, &sb->buffer[y * sb->width], sb->width);
+    emit_cells(sb, &sb->buffer[y * sb->width], sb->width);
     if (y < sb->height - 1) {
-      write(STDOUT_FILENO, "\r\n", 2);
+      term_write("\r\n", 2);
     }
   }
+
+  memcpy(sb->front, sb->buffer, sizeof(Cell) * sb->width * sb->height);
+  sb->front_origin_x = sb->origin_x;
+  sb->front_origin_y = sb->origin_y;
+  sb->full_redraw = false;
+}
+
+static void render_row_diff(ScreenBuffer *sb, int y) {
+  const Cell *back = &sb->buffer[y * sb->width];
+  Cell *front = &sb->front[y * sb->width];
+  int x = 0;
+
+  while (x < sb->width) {
+    // Skip cells the terminal already shows
+    while (x < sb->width && cell_equal(&back[x], &front[x]))
+      x++;
+    if (x >= sb->width)
+      break;
+
+    // Extend the run until a long enough stretch of unchanged cells
+    int start = x;
+    int end = x + 1; // Exclusive end of the last changed cell
+    for (x = end; x < sb->width && x - end <= RENDER_RUN_GAP; x++) {
+      if (!cell_equal(&back[x], &front[x]))
+        end = x + 1;
+    }
+
+    term_move_cursor(start, y);
+    emit_cells(sb, &back[start], end - start);
+    memcpy(&front[start], &back[start], sizeof(Cell) * (end - start));
+    x = end;
+  }
+}
+
+void screen_buffer_render(ScreenBuffer *sb) {
+  PROF_BEGIN(PROF_PRESENT);
+  term_sync_begin();
+  if (sb->full_redraw) {
+    render_full(sb);
+  } else {
+    apply_camera_scroll(sb);
+    for (int y = 0; y < sb->height; y++) {
+      // Rows that did not change at all are skipped with a single compare
+      if (memcmp(&sb->buffer[y * sb->width], &sb->front[y * sb->width],
+                 sizeof(Cell) * sb->width) != 0) {
+        render_row_diff(sb, y);
+      }
+    }
+  }
+
+  // The whole frame goes out in one write()
+  term_sync_end();
+  term_flush();
+  PROF_END(PROF_PRESENT);
 }
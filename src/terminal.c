@@ -1,10 +1,90 @@
 #include "terminal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
+#define OUTPUT_INITIAL_CAPACITY 16384
+
+// Frame output buffer shared by every term_* helper
+static char *out_data = NULL;
+static size_t out_len = 0;
+static size_t out_cap = 0;
+static TermStats out_stats;
+
+// Output backend; frames go to out_fd unless captured or discarded
+static TermBackend out_backend = TERM_BACKEND_TTY;
+static int out_fd = STDOUT_FILENO;
+
+// Frames kept by TERM_BACKEND_MEMORY
+static char *capture_data = NULL;
+static size_t capture_len = 0;
+static size_t capture_cap = 0;
+
+// Scripted input for headless backends
+static const char *script_pos = NULL;
+static bool script_line_served = false;
+
+// Keys that arrived while waiting for capability answers, kept for
+// term_take_probe_input()
+static char probe_input[256];
+static size_t probe_input_len = 0;
+
+// Capabilities used by the output path; headless backends keep the default
+static TermCaps out_caps = {false, false, false, true};
+
+// Output length when term_sync_begin() was called, -1 outside a frame
+static long sync_mark = -1;
+
+#define SYNC_BEGIN "\x1b[?2026h"
+#define SYNC_END "\x1b[?2026l"
+
+// Kitty keyboard flags pushed while running: disambiguate escape codes (1),
+// report press/repeat/release (2) and send every key as an escape code (8)
+#define KITTY_KEYBOARD_PUSH "\x1b[>11u"
+#define KITTY_KEYBOARD_POP "\x1b[<u"
+
+// How long to wait for answers to the capability queries
+#define CAPS_QUERY_TIMEOUT_MS 200
+
+// Fallback capabilities by $TERM prefix, first match wins. Fields are
+// {sync_output, truecolor, kitty_keyboard, scroll_regions}.
+static const struct {
+  const char *term;
+  TermCaps caps;
+} caps_table[] = {
+    {"xterm-kitty", {true, true, true, true}},
+    {"xterm-ghostty", {true, true, true, true}},
+    {"foot", {true, true, true, true}},
+    {"wezterm", {true, true, true, true}},
+    {"alacritty", {true, true, true, true}},
+    {"contour", {true, true, false, true}},
+    {"tmux", {false, false, false, true}},
+    {"screen", {false, false, false, true}},
+    {"xterm", {false, false, false, true}},
+    {"rxvt", {false, false, false, true}},
+    {"linux", {false, false, false, true}},
+    {"vt100", {false, false, false, true}},
+    {"dumb", {false, false, false, false}},
+};
+
+// Pre-encoded SGR sequences, indexed by (attr << 8 | bg << 4 | fg)
+#define SGR_CACHE_SIZE 4096
+#define SGR_MAX_LEN 24
+static struct {
+  unsigned char len; // 0 until first use
+  char seq[SGR_MAX_LEN];
+} sgr_cache[SGR_CACHE_SIZE];
+
 int terminal_init(Terminal *term) {
+  term->backend = TERM_BACKEND_TTY;
+  out_backend = TERM_BACKEND_TTY;
+  out_fd = STDOUT_FILENO;
+
   // Get original terminal settings
   if (tcgetattr(STDIN_FILENO, &term->orig_termios) == -1) {
     perror("tcgetattr");
@@ -17,8 +97,10 @@ int terminal_init(Terminal *term) {
   raw.c_oflag &= ~(OPOST);
   raw.c_cflag |= (CS8);
   raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+  // Reads return at once with whatever is queued; game_run() polls stdin
+  // for readiness instead of waiting in read()
   raw.c_cc[VMIN] = 0;
-  raw.c_cc[VTIME] = 1;
+  raw.c_cc[VTIME] = 0;
 
   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) {
     perror("tcsetattr");
@@ -27,19 +109,249 @@ int terminal_init(Terminal *term) {
 
   // Get terminal size
   terminal_get_size(term);
+  terminal_detect_caps(term);
+
+  if (term->caps.kitty_keyboard)
+    term_write(KITTY_KEYBOARD_PUSH, sizeof(KITTY_KEYBOARD_PUSH) - 1);
 
   // Hide cursor and clear screen
   term_hide_cursor();
   term_clear_screen();
+  term_flush();
+
+  return 0;
+}
+
+int terminal_init_headless(Terminal *term, TermBackend backend,
+                           const char *path, int width, int height) {
+  static const TermCaps headless_caps = {false, false, false, true};
+
+  term->backend = backend;
+  term->width = width;
+  term->height = height;
+  term->caps = headless_caps;
+  out_backend = backend;
+  out_fd = -1;
+  out_caps = headless_caps;
+
+  if (backend == TERM_BACKEND_TTY)
+    return -1;
+  if (backend == TERM_BACKEND_FILE) {
+    out_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd == -1) {
+      perror(path);
+      return -1;
+    }
+  }
+
+  term_hide_cursor();
+  term_clear_screen();
+  term_flush();
 
   return 0;
 }
 
 void terminal_restore(Terminal *term) {
+  if (term->backend == TERM_BACKEND_TTY && term->caps.kitty_keyboard)
+    term_write(KITTY_KEYBOARD_POP, sizeof(KITTY_KEYBOARD_POP) - 1);
+  term_reset_color();
   term_show_cursor();
   term_clear_screen();
   term_move_cursor(0, 0);
-  tcsetattr(STDIN_FILENO, TCSAFLUSH, &term->orig_termios);
+  term_flush();
+
+  if (term->backend == TERM_BACKEND_TTY) {
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &term->orig_termios);
+  } else if (term->backend == TERM_BACKEND_FILE) {
+    close(out_fd);
+  }
+  out_backend = TERM_BACKEND_TTY;
+  out_fd = STDOUT_FILENO;
+
+  free(out_data);
+  out_data = NULL;
+  out_len = 0;
+  out_cap = 0;
+  free(capture_data);
+  capture_data = NULL;
+  capture_len = 0;
+  capture_cap = 0;
+  script_pos = NULL;
+  probe_input_len = 0;
+}
+
+// Apply a $TARIO_CAPS style list such as "-sync,+truecolor"
+static void apply_caps_override(TermCaps *caps, const char *spec) {
+  while (*spec) {
+    bool on = *spec != '-';
+    if (*spec == '+' || *spec == '-')
+      spec++;
+    size_t len = strcspn(spec, ",");
+
+    if (len == 4 && strncmp(spec, "sync", len) == 0)
+      caps->sync_output = on;
+    else if (len == 9 && strncmp(spec, "truecolor", len) == 0)
+      caps->truecolor = on;
+    else if (len == 5 && strncmp(spec, "kitty", len) == 0)
+      caps->kitty_keyboard = on;
+    else if (len == 6 && strncmp(spec, "scroll", len) == 0)
+      caps->scroll_regions = on;
+
+    spec += len;
+    if (*spec == ',')
+      spec++;
+  }
+}
+
+// Read capability answers: from the tty, waiting up to the timeout, or for
+// headless backends from the input script, where an empty read ends them
+static int probe_read(char *buf, size_t size) {
+  if (out_backend != TERM_BACKEND_TTY)
+    return term_read_input(buf, (int)size);
+
+  struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+  if (poll(&pfd, 1, CAPS_QUERY_TIMEOUT_MS) <= 0)
+    return 0;
+  ssize_t n = read(STDIN_FILENO, buf, size);
+  return n > 0 ? (int)n : 0;
+}
+
+// Take the answers (ESC [ ? ... with a final byte) out of buf, noting what
+// they say in caps, and close up the bytes around them, which are keys.
+// An answer cut off at the end stays for the next read. Returns true once
+// the DA1 answer has arrived.
+static bool take_caps_replies(TermCaps *caps, char *buf, size_t *len) {
+  bool done = false;
+  size_t in = 0, out = 0;
+
+  while (in < *len) {
+    size_t left = *len - in;
+    if (memcmp(buf + in, "\x1b[?", left < 3 ? left : 3) != 0) {
+      buf[out++] = buf[in++];
+      continue;
+    }
+
+    size_t end = in + 3;
+    while (end < *len && buf[end] != '\0' && strchr("0123456789;$", buf[end]))
+      end++;
+    if (end >= *len) {
+      // Incomplete: keep it in front of the next read
+      memmove(buf + out, buf + in, left);
+      out += left;
+      break;
+    }
+
+    const char *params = buf + in + 3;
+    if (buf[end] == 'c') {
+      // Primary device attributes: ESC [ ? ... c
+      done = true;
+    } else if (buf[end] == 'u' && end > in + 3) {
+      // Kitty keyboard flags: ESC [ ? flags u
+      caps->kitty_keyboard = true;
+    } else if (buf[end] == 'y' && strncmp(params, "2026;", 5) == 0) {
+      // DECRPM: ESC [ ? 2026 ; Ps $ y, where Ps 1 or 2 means supported
+      caps->sync_output = params[5] == '1' || params[5] == '2';
+    }
+    in = end + 1;
+  }
+  *len = out;
+  return done;
+}
+
+// Ask the terminal about mode 2026 and the kitty keyboard protocol. Primary
+// device attributes go last: every terminal answers them, so their reply
+// marks the end of the answers to wait for. Keys typed meanwhile are kept.
+static void query_caps(TermCaps *caps) {
+  static const char query[] = "\x1b[?2026$p\x1b[?u\x1b[c";
+  if (out_backend == TERM_BACKEND_TTY &&
+      write(STDOUT_FILENO, query, sizeof(query) - 1) < 0)
+    return;
+
+  // Only what the terminal answers counts
+  TermCaps answered = *caps;
+  answered.sync_output = false;
+  answered.kitty_keyboard = false;
+
+  char *buf = probe_input;
+  size_t len = probe_input_len;
+  bool done = false;
+  while (!done && len < sizeof(probe_input)) {
+    int n = probe_read(buf + len, sizeof(probe_input) - len);
+    if (n <= 0)
+      break;
+    len += n;
+    done = take_caps_replies(&answered, buf, &len);
+  }
+  probe_input_len = len;
+
+  if (done)
+    *caps = answered; // Otherwise no reply: keep the table defaults
+}
+
+void terminal_query_caps(Terminal *term) {
+  query_caps(&term->caps);
+  out_caps = term->caps;
+}
+
+int term_take_probe_input(char *buf, int size) {
+  int n = probe_input_len < (size_t)size ? (int)probe_input_len : size;
+  memcpy(buf, probe_input, n);
+  memmove(probe_input, probe_input + n, probe_input_len - n);
+  probe_input_len -= n;
+  return n;
+}
+
+void terminal_detect_caps(Terminal *term) {
+  TermCaps caps = {false, false, false, true};
+
+  const char *name = getenv("TERM");
+  if (name) {
+    for (size_t i = 0; i < sizeof(caps_table) / sizeof(caps_table[0]); i++) {
+      if (strncmp(name, caps_table[i].term, strlen(caps_table[i].term)) == 0) {
+        caps = caps_table[i].caps;
+        break;
+      }
+    }
+  }
+
+  const char *colorterm = getenv("COLORTERM");
+  if (colorterm &&
+      (strcmp(colorterm, "truecolor") == 0 || strcmp(colorterm, "24bit") == 0))
+    caps.truecolor = true;
+
+  if (isatty(STDIN_FILENO) && isatty(STDOUT_FILENO) &&
+      !(name && strcmp(name, "dumb") == 0)) {
+    query_caps(&caps);
+  }
+
+  const char *spec = getenv("TARIO_CAPS");
+  if (spec)
+    apply_caps_override(&caps, spec);
+
+  term->caps = caps;
+  out_caps = caps;
+}
+
+const TermCaps *term_caps(void) { return &out_caps; }
+
+void term_set_caps(const TermCaps *caps) { out_caps = *caps; }
+
+void term_sync_begin(void) {
+  if (!out_caps.sync_output)
+    return;
+  sync_mark = (long)out_len;
+  term_write(SYNC_BEGIN, sizeof(SYNC_BEGIN) - 1);
+}
+
+void term_sync_end(void) {
+  if (sync_mark < 0)
+    return;
+  if (out_len == (size_t)sync_mark + sizeof(SYNC_BEGIN) - 1) {
+    out_len = sync_mark; // Nothing drawn: drop the opening bracket
+  } else {
+    term_write(SYNC_END, sizeof(SYNC_END) - 1);
+  }
+  sync_mark = -1;
 }
 
 void terminal_get_size(Terminal *term) {
@@ -53,25 +365,203 @@ void terminal_get_size(Terminal *term) {
   }
 }
 
-void term_clear_screen(void) {
-  write(STDOUT_FILENO, "\x1b[2J", 4);
-  write(STDOUT_FILENO, "\x1b[H", 3);
+// Write all bytes, retrying on short writes and interrupts
+static void write_all(const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(out_fd, data, len);
+    out_stats.frame_syscalls++;
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      return; // Terminal gone; drop the rest of the frame
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+void term_write(const char *data, size_t len) {
+  if (out_len + len > out_cap) {
+    size_t cap = out_cap ? out_cap : OUTPUT_INITIAL_CAPACITY;
+    while (cap < out_len + len)
+      cap *= 2;
+    char *grown = realloc(out_data, cap);
+    if (!grown) {
+      // Out of memory: send what we have and bypass the buffer
+      term_flush();
+      write_all(data, len);
+      return;
+    }
+    out_data = grown;
+    out_cap = cap;
+  }
+  memcpy(out_data + out_len, data, len);
+  out_len += len;
+}
+
+// Append a frame to the memory backend's capture buffer
+static void capture(const char *data, size_t len) {
+  if (capture_len + len > capture_cap) {
+    size_t cap = capture_cap ? capture_cap : OUTPUT_INITIAL_CAPACITY;
+    while (cap < capture_len + len)
+      cap *= 2;
+    char *grown = realloc(capture_data, cap);
+    if (!grown)
+      return;
+    capture_data = grown;
+    capture_cap = cap;
+  }
+  memcpy(capture_data + capture_len, data, len);
+  capture_len += len;
+}
+
+void term_flush(void) {
+  if (out_len == 0) {
+    out_stats.frame_bytes = 0;
+    out_stats.frame_syscalls = 0;
+    return;
+  }
+
+  out_stats.frame_syscalls = 0;
+  if (out_backend == TERM_BACKEND_MEMORY) {
+    capture(out_data, out_len);
+  } else if (out_backend != TERM_BACKEND_NULL) {
+    write_all(out_data, out_len);
+  }
+  out_stats.frame_bytes = out_len;
+  out_stats.total_bytes += out_len;
+  out_stats.total_syscalls += out_stats.frame_syscalls;
+  out_stats.flushes++;
+  out_len = 0;
 }
 
+void term_get_stats(TermStats *stats) { *stats = out_stats; }
+
+int term_output_pending(void) {
+  if (out_backend != TERM_BACKEND_TTY)
+    return 0;
+#ifdef TIOCOUTQ
+  int pending = 0;
+  if (ioctl(STDOUT_FILENO, TIOCOUTQ, &pending) == -1)
+    return 0;
+  return pending;
+#else
+  return 0;
+#endif
+}
+
+const char *term_captured_output(size_t *len) {
+  *len = capture_len;
+  return capture_data;
+}
+
+void term_clear_captured_output(void) { capture_len = 0; }
+
+int term_input_fd(void) {
+  return out_backend == TERM_BACKEND_TTY ? STDIN_FILENO : -1;
+}
+
+int term_read_input(char *buf, int size) {
+  if (out_backend == TERM_BACKEND_TTY) {
+    ssize_t n = read(STDIN_FILENO, buf, size);
+    return n > 0 ? (int)n : 0;
+  }
+
+  if (!script_pos || *script_pos == '\0')
+    return 0;
+  if (script_line_served) {
+    // End of this frame's keys; the next read starts the next line
+    script_line_served = false;
+    return 0;
+  }
+
+  int n = 0;
+  while (n < size && script_pos[n] != '\0' && script_pos[n] != '\n') {
+    buf[n] = script_pos[n];
+    n++;
+  }
+  script_pos += n;
+  if (*script_pos == '\n' || *script_pos == '\0') {
+    if (*script_pos == '\n')
+      script_pos++;
+    // An empty line already ended the frame with this read
+    script_line_served = n > 0;
+  }
+  return n;
+}
+
+void term_set_input_script(const char *script) {
+  script_pos = script;
+  script_line_served = false;
+}
+
+bool term_input_script_done(void) { return !script_pos || *script_pos == '\0'; }
+
+void term_clear_screen(void) { term_write("\x1b[2J\x1b[H", 7); }
+
 void term_move_cursor(int x, int y) {
   char buf[32];
   int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, x + 1);
-  write(STDOUT_FILENO, buf, len);
+  term_write(buf, len);
 }
 
-void term_hide_cursor(void) { write(STDOUT_FILENO, "\x1b[?25l", 6); }
+void term_hide_cursor(void) { term_write("\x1b[?25l", 6); }
 
-void term_show_cursor(void) { write(STDOUT_FILENO, "\x1b[?25h", 6); }
+void term_show_cursor(void) { term_write("\x1b[?25h", 6); }
 
 void term_set_color(int fg, int bg) {
   char buf[32];
   int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dm", fg + 30, bg + 40);
-  write(STDOUT_FILENO, buf, len);
+  term_write(buf, len);
 }
 
-void term_reset_color(void) { write(STDOUT_FILENO, "\x1b[0m", 4); }
+void term_reset_color(void) { term_write("\x1b[0m", 4); }
+
+// Append "ESC [ n <final>"
+static void write_csi(int n, char final) {
+  char buf[16];
+  int len = snprintf(buf, sizeof(buf), "\x1b[%d%c", n, final);
+  term_write(buf, len);
+}
+
+void term_set_scroll_region(int top, int bottom) {
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dr", top + 1, bottom);
+  term_write(buf, len);
+}
+
+void term_reset_scroll_region(void) { term_write("\x1b[r", 3); }
+
+void term_scroll_up(int n) { write_csi(n, 'S'); }
+
+void term_scroll_down(int n) { write_csi(n, 'T'); }
+
+void term_insert_chars(int n) { write_csi(n, '@'); }
+
+void term_delete_chars(int n) { write_csi(n, 'P'); }
+
+void term_set_style(int fg, int bg, int attr) {
+  int key = ((attr & 0xF) << 8) | ((bg & 0xF) << 4) | (fg & 0xF);
+
+  if (sgr_cache[key].len == 0) {
+    // Reset first so the sequence is correct whatever style came before
+    char *seq = sgr_cache[key].seq;
+    int len = snprintf(seq, SGR_MAX_LEN, "\x1b[0");
+    if (attr & ATTR_BOLD)
+      len += snprintf(seq + len, SGR_MAX_LEN - len, ";1");
+    if (attr & ATTR_DIM)
+      len += snprintf(seq + len, SGR_MAX_LEN - len, ";2");
+    if (attr & ATTR_UNDERLINE)
+      len += snprintf(seq + len, SGR_MAX_LEN - len, ";4");
+    if (attr & ATTR_REVERSE)
+      len += snprintf(seq + len, SGR_MAX_LEN - len, ";7");
+    if (fg != COLOR_DEFAULT)
+      len += snprintf(seq + len, SGR_MAX_LEN - len, ";%d", (fg & 0x7) + 30);
+    if (bg != COLOR_DEFAULT)
+      len += snprintf(seq + len, SGR_MAX_LEN - len, ";%d", (bg & 0x7) + 40);
+    len += snprintf(seq + len, SGR_MAX_LEN - len, "m");
+    sgr_cache[key].len = (unsigned char)len;
+  }
+
+  term_write(sgr_cache[key].seq, sgr_cache[key].len);
+}
@@ -7,11 +7,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
 
 // Include game headers (testing internals)
 #include "../include/player.h"
 #include "../include/level.h"
+#include "../include/levelgen.h"
+#include "../include/entity.h"
 #include "../include/render.h"
+#include "../include/game.h"
+#include "../include/present.h"
+#include "../include/input.h"
+#include "../include/profile.h"
 
 // Test framework macros
 #define TEST(name) void test_##name()
@@ -35,6 +44,187 @@
 // Global test counter
 static int tests_passed = 0;
 
+// Redirect stdout to /dev/null while a test renders escape sequences
+static int saved_stdout = -1;
+
+static void silence_stdout(void) {
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+}
+
+static void restore_stdout(void) {
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+}
+
+static int saved_stderr = -1;
+
+static void silence_stderr(void) {
+    fflush(stderr);
+    saved_stderr = dup(STDERR_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDERR_FILENO);
+    close(devnull);
+}
+
+static void restore_stderr(void) {
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+}
+
+// Check whether captured output contains a string
+static int output_contains(const char *out, size_t len, const char *str) {
+    size_t n = strlen(str);
+    for (size_t i = 0; i + n <= len; i++) {
+        if (memcmp(out + i, str, n) == 0) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Minimal VT emulator: replays captured output so tests can check that the
+ * terminal ends up showing exactly what the screen buffer holds
+ */
+
+#define VT_MAX_W 128
+#define VT_MAX_H 64
+
+typedef struct {
+    Cell cells[VT_MAX_H][VT_MAX_W];
+    int width, height;
+    int cx, cy;
+    int top, bottom; // Scroll region, bottom exclusive
+    Cell pen;
+} VirtualTerm;
+
+static void vt_init(VirtualTerm *vt, int width, int height) {
+    vt->width = width;
+    vt->height = height;
+    vt->cx = vt->cy = 0;
+    vt->top = 0;
+    vt->bottom = height;
+    vt->pen = CELL_BLANK;
+    for (int y = 0; y < VT_MAX_H; y++)
+        for (int x = 0; x < VT_MAX_W; x++) vt->cells[y][x] = CELL_BLANK;
+}
+
+static Cell vt_blank(VirtualTerm *vt) {
+    Cell c = CELL_BLANK;
+    c.bg = vt->pen.bg; // Erased cells take the current background
+    return c;
+}
+
+static void vt_scroll(VirtualTerm *vt, int n) {
+    // n > 0 scrolls the region up, n < 0 down
+    int rows = vt->bottom - vt->top;
+    for (int i = 0; i < rows; i++) {
+        int y = n > 0 ? vt->top + i : vt->bottom - 1 - i;
+        int src = y + n;
+        for (int x = 0; x < vt->width; x++) {
+            vt->cells[y][x] = (src >= vt->top && src < vt->bottom)
+                                  ? vt->cells[src][x] : vt_blank(vt);
+        }
+    }
+}
+
+static void vt_sgr(VirtualTerm *vt, const int *params, int count) {
+    if (count == 0) vt->pen = CELL_BLANK;
+    for (int i = 0; i < count; i++) {
+        int p = params[i];
+        if (p == 0) vt->pen = CELL_BLANK;
+        else if (p == 1) vt->pen.attr |= ATTR_BOLD;
+        else if (p == 2) vt->pen.attr |= ATTR_DIM;
+        else if (p == 4) vt->pen.attr |= ATTR_UNDERLINE;
+        else if (p == 7) vt->pen.attr |= ATTR_REVERSE;
+        else if (p >= 30 && p <= 37) vt->pen.fg = p - 30;
+        else if (p == 39) vt->pen.fg = COLOR_DEFAULT;
+        else if (p >= 40 && p <= 47) vt->pen.bg = p - 40;
+        else if (p == 49) vt->pen.bg = COLOR_DEFAULT;
+    }
+}
+
+static void vt_feed(VirtualTerm *vt, const char *data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        char c = data[i++];
+        if (c == '\r') { vt->cx = 0; continue; }
+        if (c == '\n') { if (vt->cy < vt->height - 1) vt->cy++; continue; }
+        if (c != '\x1b') {
+            if (vt->cx < vt->width) {
+                Cell cell = vt->pen;
+                cell.ch = c;
+                vt->cells[vt->cy][vt->cx++] = cell;
+            }
+            continue;
+        }
+        if (i >= len || data[i] != '[') continue;
+        i++;
+
+        // CSI: optional private marker, numeric params, final byte
+        int params[16], count = 0, value = -1, private_mode = 0;
+        while (i < len) {
+            c = data[i++];
+            if (c == '?' || c == '>' || c == '<' || c == '=') private_mode = 1;
+            else if (c >= '0' && c <= '9') value = (value < 0 ? 0 : value * 10) + (c - '0');
+            else if (c == ';' || c == ':') { if (count < 16) params[count++] = value < 0 ? 0 : value; value = -1; }
+            else if (c == '$' || c == ' ') continue;
+            else break;
+        }
+        if (value >= 0 && count < 16) params[count++] = value;
+        int n = (count > 0 && params[0] > 0) ? params[0] : 1;
+        if (private_mode) continue;
+
+        switch (c) {
+        case 'H':
+            vt->cy = (count > 0 && params[0] > 0 ? params[0] : 1) - 1;
+            vt->cx = (count > 1 && params[1] > 0 ? params[1] : 1) - 1;
+            break;
+        case 'J':
+            for (int y = 0; y < vt->height; y++)
+                for (int x = 0; x < vt->width; x++) vt->cells[y][x] = vt_blank(vt);
+            break;
+        case 'm': vt_sgr(vt, params, count); break;
+        case 'r':
+            vt->top = (count > 0 && params[0] > 0 ? params[0] : 1) - 1;
+            vt->bottom = count > 1 && params[1] > 0 ? params[1] : vt->height;
+            vt->cx = vt->cy = 0;
+            break;
+        case 'S': vt_scroll(vt, n); break;
+        case 'T': vt_scroll(vt, -n); break;
+        case '@':
+            for (int x = vt->width - 1; x >= vt->cx; x--)
+                vt->cells[vt->cy][x] = x - n >= vt->cx ? vt->cells[vt->cy][x - n] : vt_blank(vt);
+            break;
+        case 'P':
+            for (int x = vt->cx; x < vt->width; x++)
+                vt->cells[vt->cy][x] = x + n < vt->width ? vt->cells[vt->cy][x + n] : vt_blank(vt);
+            break;
+        }
+    }
+}
+
+// Feed the captured frame output to vt and compare it with the buffer
+static int vt_matches(VirtualTerm *vt, ScreenBuffer *sb) {
+    size_t len = 0;
+    const char *out = term_captured_output(&len);
+    vt_feed(vt, out, len);
+    term_clear_captured_output();
+
+    for (int y = 0; y < sb->height; y++) {
+        for (int x = 0; x < sb->width; x++) {
+            Cell a = vt->cells[y][x], b = sb->buffer[y * sb->width + x];
+            if (a.ch != b.ch || a.fg != b.fg || a.bg != b.bg || a.attr != b.attr) {
+                printf("\n  mismatch at %d,%d: '%c' vs '%c'", x, y, a.ch, b.ch);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
 /*
  * Player Physics Tests
  */
@@ -97,6 +287,18 @@ TEST(player_death) {
  * Level Tests
  */
 
+// Compare two levels tile by tile, through their chunk directories
+static bool same_tiles(Level *a, Level *b) {
+    if (a->width != b->width || a->height != b->height) return false;
+    for (int y = 0; y < a->height; y++) {
+        for (int x = 0; x < a->width; x++) {
+            if (level_get_tile(a, x, y) != level_get_tile(b, x, y))
+                return false;
+        }
+    }
+    return true;
+}
+
 TEST(level_init) {
     Level level;
     level_init(&level);
@@ -105,6 +307,8 @@ TEST(level_init) {
     // Just check that we can access tiles without crashing
     TileType tile = level_get_tile(&level, 0, 0);
     (void)tile; // Suppress unused variable warning
+
+    level_free(&level);
 }
 
 TEST(level_solid_detection) {
@@ -126,6 +330,8 @@ TEST(level_solid_detection) {
 
     // Basic check: level should have some solid tiles
     ASSERT(found_ground == 1);
+
+    level_free(&level);
 }
 
 TEST(level_boundary_checks) {
@@ -137,6 +343,8 @@ TEST(level_boundary_checks) {
     ASSERT_EQ(level_is_solid(&level, 0, -1), 0);
     ASSERT_EQ(level_is_solid(&level, LEVEL_WIDTH + 1, 0), 0);
     ASSERT_EQ(level_is_solid(&level, 0, LEVEL_HEIGHT + 1), 0);
+
+    level_free(&level);
 }
 
 TEST(level_coin_collection) {
@@ -162,6 +370,8 @@ TEST(level_coin_collection) {
         level_collect_coin(&level, coin_x, coin_y);
         ASSERT(level_is_coin(&level, coin_x, coin_y) == 0);
     }
+
+    level_free(&level);
 }
 
 TEST(level_deadly_tiles) {
@@ -182,6 +392,8 @@ TEST(level_deadly_tiles) {
 
     // Level should have some hazards
     ASSERT(found_spike == 1);
+
+    level_free(&level);
 }
 
 TEST(level_goal_exists) {
@@ -202,6 +414,791 @@ TEST(level_goal_exists) {
 
     // Level must have a goal
     ASSERT(found_goal == 1);
+
+    level_free(&level);
+}
+
+TEST(level_load_matches_builtin) {
+    Level builtin, loaded;
+    ASSERT_EQ(level_init(&builtin), 0);
+    ASSERT_EQ(level_load(&loaded, "levels/level1.tario"), 0);
+
+    ASSERT_EQ(loaded.width, builtin.width);
+    ASSERT_EQ(loaded.height, builtin.height);
+    ASSERT_EQ(loaded.spawn_x, 5);
+    ASSERT_EQ(loaded.spawn_y, 40);
+    ASSERT_EQ(loaded.number, 1);
+    ASSERT(strcmp(loaded.name, "World 1") == 0);
+    ASSERT(same_tiles(&loaded, &builtin));
+
+    level_free(&loaded);
+    level_free(&builtin);
+}
+
+TEST(level_parse_validation) {
+    Level level;
+    const char *ok = "# comment\r\nWIDTH 4\r\nHEIGHT 3\r\nSPAWN 1 1\r\n\r\n"
+                     "\r\n o\r\n####\r\n";
+    ASSERT_EQ(level_parse(&level, ok, strlen(ok), "ok"), 0);
+    ASSERT_EQ(level_get_tile(&level, 1, 1), TILE_COIN);
+    ASSERT_EQ(level_get_tile(&level, 3, 1), TILE_EMPTY);
+    ASSERT(level_is_solid(&level, 3, 2));
+    ASSERT(level.name[0] == '\0');
+    level_free(&level);
+
+    // Long names are cut to fit
+    char named[256];
+    snprintf(named, sizeof(named), "NAME %0100d\nWIDTH 1\nHEIGHT 1\n\n#\n",
+             0);
+    ASSERT_EQ(level_parse(&level, named, strlen(named), "named"), 0);
+    ASSERT_EQ(strlen(level.name), LEVEL_NAME_MAX - 1);
+    ASSERT(level.name[0] == '0');
+    level_free(&level);
+
+    // Each of these is rejected with a message and leaves level alone
+    const char *bad[] = {
+        "WIDTH 4\nHEIGHT 2\n\n#x##\n",        // Unknown tile
+        "WIDTH 4\nHEIGHT 2\n\n#####\n",       // Row too wide
+        "WIDTH 4\nHEIGHT 1\n\n####\n####\n",  // Too many rows
+        "WIDTH 4\nHEIGHT 1\nSPAWN 9 0\n\n",   // Spawn outside
+        "WIDTH 4\nHEIGHT 1\nSPAWN -1 0\n\n",  // Spawn left of the level
+        "SPAWN -1 5\nWIDTH 4\nHEIGHT 9\n\n",  // Not taken as no SPAWN
+        "WIDTH 4\nHIGHT 1\n\n",               // Unknown header
+        "WIDTH 4\n\n####\n",                  // No height
+        "WIDTH 4\nHEIGHT 1\n",                // No rows
+    };
+    level.chunks = NULL;
+    silence_stderr();
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        ASSERT_EQ(level_parse(&level, bad[i], strlen(bad[i]), "bad"), -1);
+        ASSERT(level.chunks == NULL);
+    }
+    ASSERT_EQ(level_load(&level, "levels/missing.tario"), -1);
+    restore_stderr();
+}
+
+TEST(level_parse_large) {
+    // A 4096x1024 level, about 4 MB of text
+    int width = 4096, height = 1024;
+    size_t len = 64 + (size_t)(width + 1) * height;
+    char *text = malloc(len);
+    ASSERT(text != NULL);
+    int pos = snprintf(text, len, "WIDTH %d\nHEIGHT %d\n\n", width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            text[pos++] = y == height - 1 ? '#' : (x % 97 == y % 97 ? 'o' : ' ');
+        }
+        text[pos++] = '\n';
+    }
+
+    Level level;
+    ASSERT_EQ(level_parse(&level, text, pos, "large"), 0);
+    ASSERT_EQ(level.width, width);
+    ASSERT_EQ(level.height, height);
+    ASSERT(level_is_solid(&level, width - 1, height - 1));
+    ASSERT(level_is_coin(&level, 100, 3));
+    ASSERT(!level_is_coin(&level, 101, 3));
+
+    level_free(&level);
+    free(text);
+}
+
+TEST(level_binary_round_trip) {
+    Level level, decoded;
+    ASSERT_EQ(level_load(&level, "levels/level1.tario"), 0);
+
+    unsigned char *data;
+    size_t len;
+    ASSERT_EQ(level_encode(&level, &data, &len), 0);
+    ASSERT(len < 1024); // 10000 tiles, mostly empty runs
+    ASSERT(memcmp(data, LEVEL_BIN_MAGIC, 4) == 0);
+
+    ASSERT_EQ(level_decode(&decoded, data, len, "mem"), 0);
+    ASSERT_EQ(decoded.width, level.width);
+    ASSERT_EQ(decoded.height, level.height);
+    ASSERT_EQ(decoded.spawn_x, level.spawn_x);
+    ASSERT_EQ(decoded.spawn_y, level.spawn_y);
+    ASSERT_EQ(decoded.number, 1);
+    ASSERT(strcmp(decoded.name, "World 1") == 0);
+    ASSERT(same_tiles(&decoded, &level));
+    level_free(&decoded);
+
+    // Through a file, picked by its magic
+    char path[] = "/tmp/tario_level_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+    ASSERT_EQ(level_save(&level, path), 0);
+    ASSERT_EQ(level_load(&decoded, path), 0);
+    unlink(path);
+    ASSERT(same_tiles(&decoded, &level));
+    level_free(&decoded);
+
+    // Any flipped bit or missing byte is caught
+    decoded.chunks = NULL;
+    silence_stderr();
+    data[len / 2] ^= 0x10;
+    ASSERT_EQ(level_decode(&decoded, data, len, "mem"), -1);
+    data[len / 2] ^= 0x10;
+    ASSERT_EQ(level_decode(&decoded, data, len - 1, "mem"), -1);
+    restore_stderr();
+    ASSERT(decoded.chunks == NULL);
+
+    free(data);
+    level_free(&level);
+}
+
+TEST(level_binary_edge_chunks) {
+    // Sizes that are not chunk multiples exercise the clipped edge chunks
+    const char *text = "WIDTH 70\nHEIGHT 33\nSPAWN 0 0\n\n"
+                       "F\n\n\n#=#=#=#=#=#=#=#=#=#=#=#=#=#=#=#=#=#=#=#=#=#=#=#="
+                       "#=#=#=#=#=#=#=#=#=#=#o\n";
+    Level level, decoded;
+    ASSERT_EQ(level_parse(&level, text, strlen(text), "edge"), 0);
+
+    unsigned char *data;
+    size_t len;
+    ASSERT_EQ(level_encode(&level, &data, &len), 0);
+    ASSERT_EQ(level_decode(&decoded, data, len, "edge"), 0);
+    ASSERT(same_tiles(&decoded, &level));
+    ASSERT_EQ(level_get_tile(&decoded, 69, 3), TILE_COIN);
+
+    free(data);
+    level_free(&decoded);
+    level_free(&level);
+}
+
+TEST(level_sparse_chunks) {
+    // 200000 columns: 64 rows of sky holding one coin over 32 rows of ground
+    int width = 200000, height = 96;
+    size_t len = 64 + 64 + 1002 + (size_t)(width + 1) * 32;
+    char *text = malloc(len);
+    ASSERT(text != NULL);
+    int pos = snprintf(text, len, "WIDTH %d\nHEIGHT %d\n\n", width, height);
+    for (int y = 0; y < 64; y++) {
+        if (y == 40) {
+            memset(text + pos, ' ', 1000);
+            pos += 1000;
+            text[pos++] = 'o';
+        }
+        text[pos++] = '\n';
+    }
+    for (int y = 64; y < height; y++) {
+        memset(text + pos, '#', width);
+        pos += width;
+        text[pos++] = '\n';
+    }
+
+    Level level;
+    ASSERT_EQ(level_parse(&level, text, pos, "sparse"), 0);
+    free(text);
+
+    // Only the coin's chunk has storage of its own; the rest is shared
+    ASSERT_EQ(level.chunks_x, 6250);
+    ASSERT_EQ(level.chunks_y, 3);
+    ASSERT_EQ(level.chunks_owned, 1);
+    ASSERT(level_memory_usage(&level) < 256 * 1024);
+    ASSERT(level_is_coin(&level, 1000, 40));
+    ASSERT(level_is_solid(&level, width - 1, height - 1));
+    ASSERT(!level_is_solid(&level, width - 1, 63));
+
+    // Spans stop at chunk edges
+    int count;
+    const unsigned char *span = level_get_row_span(&level, 1000, 40, &count);
+    ASSERT(span != NULL && span[0] == TILE_COIN);
+    ASSERT_EQ(count, 24);
+    span = level_get_row_span(&level, width - 3, 70, &count);
+    ASSERT_EQ(count, 3);
+
+    // Writing into a shared chunk copies it and leaves the others alone
+    ASSERT_EQ(level_set_tile(&level, 5000, 80, TILE_EMPTY), 0);
+    ASSERT_EQ(level.chunks_owned, 2);
+    ASSERT_EQ(level_get_tile(&level, 5000, 80), TILE_EMPTY);
+    ASSERT(level_is_solid(&level, 5001, 80));
+    ASSERT(level_is_solid(&level, 5000 + 64, 80));
+    ASSERT_EQ(level_set_tile(&level, width, 0, TILE_COIN), -1);
+
+    level_collect_coin(&level, 1000, 40);
+    ASSERT(!level_is_coin(&level, 1000, 40));
+    ASSERT_EQ(level.chunks_owned, 2);
+
+    // Encoding and decoding keeps the sharing
+    unsigned char *data;
+    size_t data_len;
+    Level decoded;
+    ASSERT_EQ(level_encode(&level, &data, &data_len), 0);
+    ASSERT_EQ(level_decode(&decoded, data, data_len, "sparse"), 0);
+    ASSERT_EQ(decoded.chunks_owned, 1);
+    ASSERT_EQ(level_get_tile(&decoded, 5000, 80), TILE_EMPTY);
+    ASSERT(level_is_solid(&decoded, 4999, 80));
+    free(data);
+
+    level_free(&decoded);
+    level_free(&level);
+}
+
+TEST(level_tile_flags_and_query) {
+    // The flags table agrees with the per-tile queries
+    ASSERT_EQ(level_tile_flags[TILE_EMPTY], 0);
+    ASSERT_EQ(level_tile_flags['x'], 0);
+    ASSERT_EQ(level_tile_flags[TILE_QUESTION], TILE_FLAG_SOLID);
+    ASSERT_EQ(level_tile_flags[TILE_PLATFORM], TILE_FLAG_ONE_WAY);
+
+    const char *text = "WIDTH 40\nHEIGHT 4\nSPAWN 0 0\n\n"
+                       "  o                                   ^\n"
+                       "  F\n"
+                       "########################################\n"
+                       "#####=##################################\n";
+    Level level;
+    ASSERT_EQ(level_parse(&level, text, strlen(text), "flags"), 0);
+
+    TileQuery q = level_query_rect(&level, 2, 0, 2, 3);
+    ASSERT_EQ(q.any, TILE_FLAG_COLLECTIBLE | TILE_FLAG_GOAL | TILE_FLAG_SOLID);
+    ASSERT_EQ(q.all, 0);
+
+    // Crosses the chunk boundary at x = 32
+    q = level_query_rect(&level, 0, 2, 39, 3);
+    ASSERT_EQ(q.any, TILE_FLAG_SOLID);
+    ASSERT_EQ(q.all, TILE_FLAG_SOLID);
+    q = level_query_rect(&level, 30, 0, 39, 0);
+    ASSERT_EQ(q.any, TILE_FLAG_DEADLY);
+
+    // Outside the level counts as empty
+    q = level_query_rect(&level, 0, 2, 40, 3);
+    ASSERT_EQ(q.any, TILE_FLAG_SOLID);
+    ASSERT_EQ(q.all, 0);
+    q = level_query_rect(&level, -5, -5, -1, -1);
+    ASSERT_EQ(q.any, 0);
+    q = level_query_rect(&level, 3, 0, 2, 0);
+    ASSERT_EQ(q.any, 0);
+
+    level_free(&level);
+}
+
+TEST(level_row_layers) {
+    const char *text = "WIDTH 100\nHEIGHT 3\nSPAWN 0 0\n\n"
+                       "   o                                 ^"
+                       "                              -    =\n"
+                       "\n"
+                       "####################################################"
+                       "################################################\n";
+    Level level;
+    ASSERT_EQ(level_parse(&level, text, strlen(text), "layers"), 0);
+
+    // Across chunk boundaries, in both directions, clipped to the level
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_SOLID, 0, 0, 99), 73);
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_DEADLY, 0, 0, 99), 37);
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_DEADLY, 0, 38, 99), -1);
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_COLLECTIBLE, 0, -10, 3),
+              3);
+    ASSERT_EQ(level_row_find_first(&level,
+                                   TILE_FLAG_SOLID | TILE_FLAG_ONE_WAY, 0, 4,
+                                   200),
+              68);
+    ASSERT_EQ(level_row_find_last(&level, TILE_FLAG_SOLID, 2, 0, 200), 99);
+    ASSERT_EQ(level_row_find_last(&level, TILE_FLAG_SOLID, 2, 10, 40), 40);
+    ASSERT_EQ(level_row_find_last(&level, TILE_FLAG_DEADLY, 0, 0, 36), -1);
+    ASSERT_EQ(level_row_find_last(&level, TILE_FLAG_ONE_WAY, 0, 0, 99), 68);
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_SOLID, 1, 0, 99), -1);
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_SOLID, 3, 0, 99), -1);
+
+    // Mutations keep the layers in step with the tiles
+    level_collect_coin(&level, 3, 0);
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_COLLECTIBLE, 0, 0, 99),
+              -1);
+    ASSERT_EQ(level_set_tile(&level, 70, 2, TILE_SPIKE), 0);
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_DEADLY, 2, 0, 99), 70);
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_SOLID, 2, 70, 99), 71);
+
+    level_free(&level);
+}
+
+// Update a streamed level over a view until its tiles match the fully
+// loaded level, waiting on the loader for up to about five seconds
+static bool stream_view(Level *streamed, Level *full, int x, int y, int w,
+                        int h) {
+    struct timespec pause = {0, 1000000};
+    for (int tries = 0; tries < 5000; tries++) {
+        level_stream_update(streamed, x, y, w, h, 0);
+        bool same = true;
+        for (int ty = y; ty < y + h && same; ty++) {
+            for (int tx = x; tx < x + w && same; tx++)
+                same = level_get_tile(streamed, tx, ty) ==
+                       level_get_tile(full, tx, ty);
+        }
+        if (same)
+            return true;
+        nanosleep(&pause, NULL);
+    }
+    return false;
+}
+
+TEST(level_streaming) {
+    // 8192x40: bricks and coins over a strip of ground
+    int width = 8192, height = 40;
+    size_t len = 64 + (size_t)(width + 1) * height;
+    char *text = malloc(len);
+    ASSERT(text != NULL);
+    int pos = snprintf(text, len, "WIDTH %d\nHEIGHT %d\n\n", width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            char tile = ' ';
+            if (y >= 32)
+                tile = '#';
+            else if (y == 30 && x % 7 == 3)
+                tile = '=';
+            else if (y == 28 && x % 50 == 0)
+                tile = 'o';
+            text[pos++] = tile;
+        }
+        text[pos++] = '\n';
+    }
+    Level full;
+    ASSERT_EQ(level_parse(&full, text, pos, "stream"), 0);
+    free(text);
+
+    char path[] = "/tmp/tario_stream_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+    ASSERT_EQ(level_save(&full, path), 0);
+    ASSERT(level_file_is_binary(path));
+
+    // Only the chunks around the spawn point are read up front
+    Level level;
+    size_t budget = 8 * sizeof(LevelChunk);
+    ASSERT_EQ(level_stream_open(&level, path, budget), 0);
+    unlink(path);
+    ASSERT(level.stream != NULL);
+    ASSERT_EQ(level.width, width);
+    ASSERT_EQ(level.spawn_x, full.spawn_x);
+    ASSERT_EQ(level_get_tile(&level, 3, 30), TILE_BRICK);
+    ASSERT(level_is_coin(&level, 50, 28));
+    ASSERT_EQ(level_get_tile(&level, 4003, 30), TILE_EMPTY);
+    ASSERT(level_tile_loaded(&level, 3, 30));
+    ASSERT(!level_tile_loaded(&level, 4003, 30));
+    ASSERT(level_tile_loaded(&full, 4003, 30));
+    LevelStreamStats stats;
+    level_stream_get_stats(&level, &stats);
+    ASSERT(stats.loaded > 0 && stats.loaded <= 6);
+
+    // A coin collected far from the spawn point stays collected
+    ASSERT(stream_view(&level, &full, 1000, 16, 80, 24));
+    level_collect_coin(&level, 1000, 28);
+    ASSERT(!level_is_coin(&level, 1000, 28));
+    level_set_tile(&full, 1000, 28, TILE_EMPTY);
+
+    // Walking the whole level keeps memory near the budget
+    for (int x = 0; x + 80 <= width; x += 40) {
+        ASSERT(stream_view(&level, &full, x, 16, 80, 24));
+        level_stream_get_stats(&level, &stats);
+        ASSERT(stats.resident <= 8 + 16);
+    }
+    level_stream_get_stats(&level, &stats);
+    ASSERT(stats.loaded >= width / LEVEL_CHUNK_SIZE);
+    ASSERT(stats.evicted > 0);
+    ASSERT_EQ(stats.errors, 0);
+    ASSERT(level_memory_usage(&level) < 64 * sizeof(LevelChunk));
+    ASSERT_EQ(level_get_tile(&level, 3, 30), TILE_BRICK);
+
+    ASSERT(stream_view(&level, &full, 960, 16, 80, 24));
+    ASSERT(!level_is_coin(&level, 1000, 28));
+    ASSERT(level_is_coin(&level, 1050, 28));
+
+    // Coin counts only cover resident chunks: the evicted one around
+    // (3000, 28) counts nothing, covered whole or in part
+    ASSERT(!level_tile_loaded(&level, 3000, 28));
+    ASSERT_EQ(level_count_coins(&level, 2976, 0, 3007, 31), 0);
+    ASSERT_EQ(level_count_coins(&level, 2990, 20, 3007, 31), 0);
+    ASSERT_EQ(level_count_coins(&level, 1024, 0, 1055, 31), 1);
+    ASSERT_EQ(level_count_coins(&level, 1040, 28, 1055, 28), 1);
+
+    // Every chunk was seen once, so the index covers the whole level
+    ASSERT_EQ(level.items.coins_total, full.items.coins_total);
+    ASSERT_EQ(level.items.coins_left, full.items.coins_left);
+    ASSERT_EQ(level.items.coins_collected, 1);
+    level_free(&level);
+    ASSERT(level.stream == NULL);
+    level_free(&full);
+
+    // Text levels and missing files cannot stream
+    silence_stderr();
+    ASSERT(!level_file_is_binary("levels/level1.tario"));
+    ASSERT_EQ(level_stream_open(&level, "levels/level1.tario", budget), -1);
+    ASSERT_EQ(level_stream_open(&level, "levels/missing.tario", budget), -1);
+    restore_stderr();
+}
+
+// Count each tile type in a level
+static void count_tiles(Level *level, long counts[256]) {
+    memset(counts, 0, 256 * sizeof(long));
+    for (int y = 0; y < level->height; y++) {
+        for (int x = 0; x < level->width; x++)
+            counts[level_get_tile(level, x, y)]++;
+    }
+}
+
+TEST(level_generate) {
+    LevelGenParams params;
+    levelgen_defaults(&params);
+    params.width = 2000;
+    params.seed = 42;
+
+    // The same parameters always give the same level
+    Level a, b;
+    ASSERT_EQ(level_generate(&a, &params), 0);
+    ASSERT_EQ(level_generate(&b, &params), 0);
+    ASSERT_EQ(a.width, 2000);
+    ASSERT_EQ(a.height, LEVEL_HEIGHT);
+    ASSERT(same_tiles(&a, &b));
+    level_free(&b);
+
+    // Spawn standing on the ground, and every feature present
+    ASSERT(!level_is_solid(&a, a.spawn_x, a.spawn_y));
+    ASSERT(level_is_solid(&a, a.spawn_x, a.spawn_y + 1));
+    long counts[256];
+    count_tiles(&a, counts);
+    ASSERT_EQ(counts[TILE_GOAL], 1);
+    ASSERT(counts[TILE_COIN] > 0);
+    ASSERT(counts[TILE_SPIKE] > 0);
+    ASSERT(counts[TILE_QUESTION] > 0);
+    ASSERT(counts[TILE_PLATFORM] > 0);
+    ASSERT(counts[TILE_PIPE_LEFT] > 0);
+    ASSERT_EQ(counts[TILE_PIPE_LEFT], counts[TILE_PIPE_RIGHT]);
+
+    // It survives the binary format
+    unsigned char *data;
+    size_t len;
+    ASSERT_EQ(level_encode(&a, &data, &len), 0);
+    ASSERT_EQ(level_decode(&b, data, len, "generated"), 0);
+    free(data);
+    ASSERT(same_tiles(&a, &b));
+    level_free(&b);
+
+    // Another seed gives another level
+    params.seed = 43;
+    ASSERT_EQ(level_generate(&b, &params), 0);
+    ASSERT(!same_tiles(&a, &b));
+    level_free(&b);
+
+    // Density 0 leaves only the floors and the goal
+    params.density = 0.0f;
+    ASSERT_EQ(level_generate(&b, &params), 0);
+    count_tiles(&b, counts);
+    ASSERT_EQ(counts[TILE_COIN] + counts[TILE_SPIKE] + counts[TILE_PIPE_LEFT],
+              0);
+    ASSERT_EQ(counts[TILE_GOAL], 1);
+    level_free(&b);
+
+    // Large levels stay sparse; tiny ones are refused
+    params.width = 200000;
+    params.density = 0.5f;
+    ASSERT_EQ(level_generate(&b, &params), 0);
+    ASSERT(level_memory_usage(&b) < 40 * 1024 * 1024);
+    level_free(&b);
+    params.width = LEVELGEN_MIN_WIDTH - 1;
+    ASSERT_EQ(level_generate(&b, &params), -1);
+    level_free(&a);
+}
+
+// Coins in a rectangle, one tile at a time
+static long scan_coins(Level *level, int x0, int y0, int x1, int y1) {
+    long coins = 0;
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++)
+            coins += level_is_coin(level, x, y);
+    }
+    return coins;
+}
+
+TEST(level_collectible_index) {
+    Level level;
+    ASSERT_EQ(level_load(&level, "levels/level1.tario"), 0);
+    long counts[256];
+    count_tiles(&level, counts);
+    ASSERT(counts[TILE_COIN] > 0);
+    ASSERT_EQ(level.items.coins_total, counts[TILE_COIN]);
+    ASSERT_EQ(level.items.coins_left, counts[TILE_COIN]);
+    ASSERT_EQ(level.items.coins_collected, 0);
+    ASSERT_EQ(level.items.questions, counts[TILE_QUESTION]);
+
+    // Whole chunks come from summaries, partial ones from the layers
+    int w = level.width, h = level.height;
+    ASSERT_EQ(level_count_coins(&level, -5, -5, w + 5, h + 5),
+              counts[TILE_COIN]);
+    int rects[][4] = {{0, 0, 31, 31}, {10, 5, 150, 40}, {33, 33, 33, 33},
+                      {100, 0, 199, 49}, {180, 30, 195, 45}};
+    for (size_t i = 0; i < sizeof(rects) / sizeof(rects[0]); i++) {
+        int *r = rects[i];
+        ASSERT_EQ(level_count_coins(&level, r[0], r[1], r[2], r[3]),
+                  scan_coins(&level, r[0], r[1], r[2], r[3]));
+    }
+    ASSERT_EQ(level_count_coins(&level, 10, 10, 5, 5), 0);
+
+    // Collecting and editing update the counts in place
+    int cx = -1, cy = -1;
+    for (int y = 0; y < h && cx < 0; y++) {
+        for (int x = 0; x < w && cx < 0; x++) {
+            if (level_is_coin(&level, x, y)) {
+                cx = x;
+                cy = y;
+            }
+        }
+    }
+    size_t chunk = (size_t)(cy / LEVEL_CHUNK_SIZE) * level.chunks_x +
+                   cx / LEVEL_CHUNK_SIZE;
+    int chunk_coins = level.chunk_items[chunk].coins;
+    level_collect_coin(&level, cx, cy);
+    level_collect_coin(&level, cx, cy);
+    ASSERT_EQ(level.items.coins_collected, 1);
+    ASSERT_EQ(level.items.coins_left, counts[TILE_COIN] - 1);
+    ASSERT_EQ(level.chunk_items[chunk].coins, chunk_coins - 1);
+    ASSERT_EQ(level_count_coins(&level, 0, 0, w - 1, h - 1),
+              counts[TILE_COIN] - 1);
+
+    ASSERT_EQ(level_set_tile(&level, 1, 1, TILE_COIN), 0);
+    ASSERT_EQ(level.items.coins_total, counts[TILE_COIN] + 1);
+    ASSERT_EQ(level.items.coins_left, counts[TILE_COIN]);
+    ASSERT_EQ(level_set_tile(&level, 2, 1, TILE_QUESTION), 0);
+    ASSERT_EQ(level.items.questions, counts[TILE_QUESTION] + 1);
+    ASSERT_EQ(level_set_tile(&level, 2, 1, TILE_EMPTY), 0);
+    ASSERT_EQ(level.items.questions, counts[TILE_QUESTION]);
+
+    // Decoding and generating build the same index
+    unsigned char *data;
+    size_t len;
+    Level decoded;
+    ASSERT_EQ(level_encode(&level, &data, &len), 0);
+    ASSERT_EQ(level_decode(&decoded, data, len, "index"), 0);
+    free(data);
+    ASSERT_EQ(decoded.items.coins_total, level.items.coins_left);
+    ASSERT_EQ(decoded.items.questions, level.items.questions);
+    level_free(&decoded);
+    level_free(&level);
+
+    LevelGenParams params;
+    levelgen_defaults(&params);
+    params.width = 5000;
+    ASSERT_EQ(level_generate(&level, &params), 0);
+    count_tiles(&level, counts);
+    ASSERT_EQ(level.items.coins_left, counts[TILE_COIN]);
+    ASSERT_EQ(level.items.questions, counts[TILE_QUESTION]);
+    ASSERT_EQ(level_count_coins(&level, 1000, 3, 3999, 47),
+              scan_coins(&level, 1000, 3, 3999, 47));
+    level_free(&level);
+}
+
+TEST(level_edit_journal) {
+    Level level, base;
+    ASSERT_EQ(level_load(&level, "levels/level1.tario"), 0);
+    ASSERT_EQ(level_load(&base, "levels/level1.tario"), 0);
+    ASSERT_EQ(level.edit_count, 0);
+
+    // Find three coins
+    int coins[3][2];
+    int found = 0;
+    for (int y = 0; y < level.height && found < 3; y++) {
+        for (int x = 0; x < level.width && found < 3; x++) {
+            if (level_is_coin(&level, x, y)) {
+                coins[found][0] = x;
+                coins[found][1] = y;
+                found++;
+            }
+        }
+    }
+    ASSERT_EQ(found, 3);
+
+    level_collect_coin(&level, coins[0][0], coins[0][1]);
+    ASSERT_EQ(level_set_tile(&level, 0, 0, TILE_COIN), 0);
+    ASSERT_EQ(level_set_tile(&level, 0, 0, TILE_COIN), 0); // No change
+    size_t mark = level_checkpoint(&level);
+    ASSERT_EQ(mark, 2);
+    level_collect_coin(&level, coins[1][0], coins[1][1]);
+    level_collect_coin(&level, coins[2][0], coins[2][1]);
+    ASSERT_EQ(level.items.coins_collected, 3);
+
+    // Back to the checkpoint: the last two coins return
+    level_rollback(&level, mark);
+    ASSERT_EQ(level.edit_count, mark);
+    ASSERT(!level_is_coin(&level, coins[0][0], coins[0][1]));
+    ASSERT(level_is_coin(&level, coins[1][0], coins[1][1]));
+    ASSERT(level_is_coin(&level, coins[2][0], coins[2][1]));
+    ASSERT_EQ(level.items.coins_collected, 1);
+    ASSERT_EQ(level.items.coins_total, base.items.coins_total + 1);
+    ASSERT_EQ(level_row_find_first(&level, TILE_FLAG_COLLECTIBLE,
+                                   coins[1][1], coins[1][0], level.width - 1),
+              coins[1][0]);
+
+    // Back to the base level
+    level_rollback(&level, 0);
+    ASSERT(same_tiles(&level, &base));
+    ASSERT_EQ(level.items.coins_total, base.items.coins_total);
+    ASSERT_EQ(level.items.coins_left, base.items.coins_left);
+    ASSERT_EQ(level.items.coins_collected, 0);
+    ASSERT_EQ(level_count_coins(&level, 0, 0, 199, 49),
+              base.items.coins_left);
+
+    // Committing makes the current tiles the base
+    level_collect_coin(&level, coins[0][0], coins[0][1]);
+    level_commit(&level);
+    level_rollback(&level, 0);
+    ASSERT(!level_is_coin(&level, coins[0][0], coins[0][1]));
+    level_free(&level);
+    level_free(&base);
+
+    // Generated levels never journal their tiles, so building one costs
+    // no memory beyond the level itself
+    LevelGenParams params;
+    levelgen_defaults(&params);
+    params.width = 2000;
+    ASSERT_EQ(level_generate(&level, &params), 0);
+    ASSERT_EQ(level.edit_count, 0);
+    ASSERT_EQ(level.edit_capacity, 0);
+    ASSERT(level.edits == NULL);
+
+    // Raw writes keep the index but are not undone
+    long total = level.items.coins_total;
+    ASSERT_EQ(level_set_tile_raw(&level, 5, 2, TILE_COIN), 0);
+    ASSERT_EQ(level.items.coins_total, total + 1);
+    ASSERT_EQ(level.edit_count, 0);
+    level_rollback(&level, 0);
+    ASSERT(level_is_coin(&level, 5, 2));
+    level_free(&level);
+}
+
+/*
+ * Entity Tests
+ */
+
+// 64x16 arena: ground on row 12 with a pit at columns 41-50, a wall at
+// column 30, and walls at 51 and 63 boxing in the right-hand floor
+static void entity_arena(Level *level) {
+    level_create(level, 64, 16);
+    for (int x = 0; x < 64; x++) {
+        if (x < 41 || x > 50)
+            level_set_tile_raw(level, x, 12, TILE_GROUND);
+    }
+    for (int y = 8; y < 12; y++) {
+        level_set_tile_raw(level, 30, y, TILE_BRICK);
+        level_set_tile_raw(level, 51, y, TILE_BRICK);
+        level_set_tile_raw(level, 63, y, TILE_BRICK);
+    }
+}
+
+TEST(entity_walkers_turn) {
+    Level level;
+    entity_arena(&level);
+    EntityStore store;
+    entity_store_init(&store);
+    ASSERT_EQ(entity_spawn(&store, ENTITY_WALKER, 10.0f, 0.0f), 0);
+    ASSERT_EQ(entity_spawn(&store, ENTITY_WALKER, 36.0f, 0.0f), 1);
+
+    // Both drop onto the ground and walk right
+    for (int i = 0; i < 60; i++)
+        entity_update(&store, &level, 1.0f / 60);
+    ASSERT_EQ(store.count, 2);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_FLOAT_EQ(store.y[i], 11.0f);
+        ASSERT(store.flags[i] & ENTITY_FLAG_ON_GROUND);
+        ASSERT(store.vel_x[i] > 0.0f);
+    }
+
+    // The first turns at the wall; the second paces between the wall and
+    // the edge of the pit without falling in
+    bool turned_at_wall = false, turned_at_ledge = false;
+    for (int i = 0; i < 900; i++) {
+        float vx = store.vel_x[1];
+        entity_update(&store, &level, 1.0f / 60);
+        ASSERT(store.x[0] < 30.0f);
+        ASSERT(store.x[1] > 30.0f && store.x[1] < 41.0f);
+        turned_at_wall |= store.vel_x[0] < 0.0f;
+        turned_at_ledge |= vx > 0.0f && store.vel_x[1] < 0.0f;
+    }
+    ASSERT(turned_at_wall);
+    ASSERT(turned_at_ledge);
+    ASSERT_EQ(store.count, 2);
+    ASSERT_FLOAT_EQ(store.y[0], 11.0f);
+    ASSERT_FLOAT_EQ(store.y[1], 11.0f);
+
+    entity_store_free(&store);
+    ASSERT_EQ(store.count, 0);
+    level_free(&level);
+}
+
+TEST(entity_jumpers_and_removal) {
+    Level level;
+    entity_arena(&level);
+    EntityStore store;
+    entity_store_init(&store);
+    entity_spawn(&store, ENTITY_WALKER, 45.0f, 0.0f); // Over the pit
+    entity_spawn(&store, ENTITY_JUMPER, 57.0f, 0.0f);
+
+    // The walker falls out of the level and the jumper takes its index
+    float top = 16.0f;
+    bool landed = false;
+    for (int i = 0; i < 300; i++) {
+        entity_update(&store, &level, 1.0f / 60);
+        int j = store.count - 1;
+        if (store.flags[j] & ENTITY_FLAG_ON_GROUND) {
+            ASSERT_FLOAT_EQ(store.y[j], 11.0f);
+            landed = true;
+        } else if (landed && store.y[j] < top) {
+            top = store.y[j];
+        }
+        ASSERT(store.x[j] > 51.0f && store.x[j] < 63.0f);
+    }
+    ASSERT_EQ(store.count, 1);
+    ASSERT_EQ(store.type[0], ENTITY_JUMPER);
+
+    // It hopped at least once after landing
+    ASSERT(landed);
+    ASSERT(top < 10.0f);
+
+    // Removal moves the last entity into the gap
+    entity_spawn(&store, ENTITY_WALKER, 5.0f, 11.0f);
+    entity_spawn(&store, ENTITY_WALKER, 6.0f, 11.0f);
+    entity_remove(&store, 0);
+    ASSERT_EQ(store.count, 2);
+    ASSERT_FLOAT_EQ(store.x[0], 6.0f);
+    ASSERT_EQ(store.type[0], ENTITY_WALKER);
+    ASSERT_FLOAT_EQ(store.x[1], 5.0f);
+
+    entity_store_free(&store);
+    level_free(&level);
+}
+
+TEST(entity_batch_update) {
+    LevelGenParams params;
+    levelgen_defaults(&params);
+    params.width = 2000;
+    Level level;
+    ASSERT_EQ(level_generate(&level, &params), 0);
+
+    // Arrays grow in place of a fixed pool
+    EntityStore store;
+    entity_store_init(&store);
+    int count = 10000;
+    for (int i = 0; i < count; i++) {
+        EntityType type = i % 2 ? ENTITY_JUMPER : ENTITY_WALKER;
+        ASSERT_EQ(entity_spawn(&store, type, 0.5f + i * 0.2f, 0.0f), i);
+    }
+    ASSERT(store.capacity >= count);
+
+    // A second of updates for ten thousand entities, with room to spare
+    // for sanitizer builds
+    uint64_t start = profile_now_ns();
+    for (int i = 0; i < 60; i++)
+        entity_update(&store, &level, 1.0f / 60);
+    double ms = (profile_now_ns() - start) / 1e6;
+    ASSERT(ms < 500.0);
+
+    // Most land somewhere; the rest fell into pits and are gone
+    ASSERT(store.count > count / 2);
+    for (int i = 0; i < store.count; i++)
+        ASSERT(store.y[i] < level.height);
+
+    entity_store_free(&store);
+    level_free(&level);
 }
 
 /*
@@ -233,6 +1230,822 @@ TEST(screen_buffer_bounds) {
     screen_buffer_free(sb);
 }
 
+TEST(screen_buffer_diff_render) {
+    ScreenBuffer *sb = screen_buffer_create(20, 5);
+    ASSERT(sb != NULL);
+    ASSERT_EQ(sb->full_redraw, 1);
+
+    silence_stdout();
+    screen_buffer_render(sb);
+    ASSERT_EQ(sb->full_redraw, 0);
+    ASSERT(memcmp(sb->front, sb->buffer, sizeof(Cell) * 20 * 5) == 0);
+
+    // Only the changed cell should be copied to the front buffer
+    screen_buffer_draw_char(sb, 7, 3, '@');
+    ASSERT(sb->front[3 * 20 + 7].ch == ' ');
+    screen_buffer_render(sb);
+    restore_stdout();
+
+    ASSERT(sb->front[3 * 20 + 7].ch == '@');
+    ASSERT(memcmp(sb->front, sb->buffer, sizeof(Cell) * 20 * 5) == 0);
+
+    screen_buffer_invalidate(sb);
+    ASSERT_EQ(sb->full_redraw, 1);
+    screen_buffer_free(sb);
+}
+
+TEST(screen_buffer_single_write_per_frame) {
+    ScreenBuffer *sb = screen_buffer_create(40, 10);
+    ASSERT(sb != NULL);
+    TermStats stats;
+
+    silence_stdout();
+    screen_buffer_render(sb);
+    term_get_stats(&stats);
+    ASSERT_EQ(stats.frame_syscalls, 1);
+    ASSERT(stats.frame_bytes >= 40 * 10);
+
+    // A one-cell change costs one write and only a few bytes
+    screen_buffer_draw_char(sb, 3, 4, '#');
+    screen_buffer_render(sb);
+    term_get_stats(&stats);
+    ASSERT_EQ(stats.frame_syscalls, 1);
+    ASSERT(stats.frame_bytes < 16);
+
+    // An unchanged frame costs nothing
+    screen_buffer_render(sb);
+    restore_stdout();
+    term_get_stats(&stats);
+    ASSERT_EQ(stats.frame_syscalls, 0);
+    ASSERT_EQ(stats.frame_bytes, 0);
+
+    screen_buffer_free(sb);
+}
+
+TEST(screen_buffer_sgr_coalescing) {
+    ScreenBuffer *sb = screen_buffer_create(40, 3);
+    ASSERT(sb != NULL);
+    TermStats stats;
+
+    silence_stdout();
+    screen_buffer_render(sb);
+
+    // A run of same-styled cells needs a single SGR sequence
+    Cell coin = {'o', COLOR_YELLOW, COLOR_DEFAULT, ATTR_BOLD};
+    for (int x = 0; x < 10; x++) {
+        screen_buffer_draw_cell(sb, x, 1, coin);
+    }
+    screen_buffer_render(sb);
+    term_get_stats(&stats);
+    size_t one_style = stats.frame_bytes;
+
+    // Alternating styles need a sequence per cell
+    Cell spike = {'^', COLOR_RED, COLOR_DEFAULT, ATTR_BOLD};
+    for (int x = 0; x < 10; x++) {
+        screen_buffer_draw_cell(sb, x, 2, (x % 2) ? spike : coin);
+    }
+    screen_buffer_render(sb);
+    restore_stdout();
+    term_get_stats(&stats);
+
+    ASSERT(one_style < 10 + 24);
+    ASSERT(stats.frame_bytes > one_style + 5 * 8);
+    ASSERT(memcmp(sb->front, sb->buffer, sizeof(Cell) * 40 * 3) == 0);
+
+    screen_buffer_free(sb);
+}
+
+TEST(term_output_pending_without_tty) {
+    // Nothing is ever queued when output is not a terminal
+    silence_stdout();
+    term_write("frame", 5);
+    term_flush();
+    int pending = term_output_pending();
+    restore_stdout();
+    ASSERT_EQ(pending, 0);
+}
+
+TEST(screen_buffer_blit_row) {
+    ScreenBuffer *sb = screen_buffer_create(20, 2);
+    ASSERT(sb != NULL);
+
+    Cell lut[256];
+    for (int i = 0; i < 256; i++) {
+        lut[i] = CELL_BLANK;
+        lut[i].ch = (char)i;
+    }
+    lut['^'].fg = COLOR_RED;
+
+    // 30 tiles starting 5 columns left of the screen: clipped on both sides
+    unsigned char tiles[30];
+    for (int i = 0; i < 30; i++) {
+        tiles[i] = (i % 3 == 0) ? '^' : '#';
+    }
+    screen_buffer_blit_row(sb, -5, 1, tiles, 30, lut);
+
+    for (int x = 0; x < 20; x++) {
+        Cell c = sb->buffer[1 * 20 + x];
+        ASSERT(c.ch == (char)tiles[x + 5]);
+        ASSERT_EQ(c.fg, tiles[x + 5] == '^' ? COLOR_RED : COLOR_DEFAULT);
+    }
+    ASSERT(sb->buffer[0].ch == ' ');
+
+    // Rows outside the buffer are ignored
+    screen_buffer_blit_row(sb, 0, 2, tiles, 30, lut);
+    screen_buffer_fill_row(sb, 15, 0, 10, lut['=']);
+    ASSERT(sb->buffer[14].ch == ' ');
+    ASSERT(sb->buffer[15].ch == '=');
+    ASSERT(sb->buffer[19].ch == '=');
+
+    screen_buffer_free(sb);
+}
+
+// Deterministic test world: sparse colored blocks on a ground line
+static Cell test_world_cell(int wx, int wy) {
+    Cell c = CELL_BLANK;
+    if (wy >= 12) {
+        c.ch = '#';
+        c.fg = COLOR_GREEN;
+    } else if ((wx * 7 + wy * 13) % 11 == 0) {
+        c.ch = 'o';
+        c.fg = COLOR_YELLOW;
+        c.attr = ATTR_BOLD;
+    } else if ((wx + wy) % 17 == 0) {
+        c.ch = '=';
+    }
+    return c;
+}
+
+TEST(screen_buffer_camera_scroll) {
+    Terminal term;
+    ASSERT_EQ(terminal_init_headless(&term, TERM_BACKEND_MEMORY, NULL, 40, 12), 0);
+    ScreenBuffer *sb = screen_buffer_create(40, 12);
+    ASSERT(sb != NULL);
+    screen_buffer_set_scroll_region(sb, 0, 10);
+
+    VirtualTerm vt;
+    vt_init(&vt, 40, 12);
+
+    // Pan right, then diagonally, then jump back left and up
+    const int path[][2] = {{0, 0}, {1, 0}, {2, 0}, {3, 0}, {5, 0}, {6, 1},
+                           {7, 2}, {7, 3}, {6, 3}, {4, 1}, {30, 0}, {2, 2}};
+    size_t scroll_bytes = 0;
+    for (int f = 0; f < (int)(sizeof(path) / sizeof(path[0])); f++) {
+        int ox = path[f][0], oy = path[f][1];
+        screen_buffer_set_origin(sb, ox, oy);
+        for (int y = 0; y < 10; y++)
+            for (int x = 0; x < 40; x++)
+                screen_buffer_draw_cell(sb, x, y, test_world_cell(x + ox, y + oy));
+        screen_buffer_fill_row(sb, 0, 10, 40, CELL_BLANK);
+        screen_buffer_draw_string(sb, 0, 11, "HUD");
+        screen_buffer_draw_char(sb, 20, 5, '@'); // Sprite fixed on screen
+
+        screen_buffer_render(sb);
+        size_t len = 0;
+        term_captured_output(&len);
+        if (f == 1) scroll_bytes = len;
+        ASSERT(vt_matches(&vt, sb));
+    }
+
+    // A one-column pan costs far less than repainting the viewport
+    ASSERT(scroll_bytes < 40 * 10 / 2);
+    ASSERT(scroll_bytes > 0);
+
+    screen_buffer_free(sb);
+    terminal_restore(&term);
+}
+
+TEST(presenter_output_thread) {
+    Terminal term;
+    ASSERT_EQ(terminal_init_headless(&term, TERM_BACKEND_MEMORY, NULL, 40, 12), 0);
+    Presenter *p = presenter_create(40, 12);
+    ASSERT(p != NULL);
+    ScreenBuffer *sb = screen_buffer_create(40, 12);
+    ASSERT(sb != NULL);
+    screen_buffer_set_scroll_region(sb, 0, 10);
+
+    // Publish a burst of frames far faster than they can all be presented
+    const int frames = 200;
+    for (int f = 0; f < frames; f++) {
+        screen_buffer_set_origin(sb, f / 4, 0);
+        for (int y = 0; y < 10; y++)
+            for (int x = 0; x < 40; x++)
+                screen_buffer_draw_cell(sb, x, y, test_world_cell(x + f / 4, y));
+        screen_buffer_fill_row(sb, 0, 10, 40, CELL_BLANK);
+        screen_buffer_fill_row(sb, 0, 11, 40, CELL_BLANK);
+        screen_buffer_draw_string(sb, 0, 11, f % 2 ? "odd" : "even");
+        presenter_publish(p, sb);
+    }
+
+    // Keep a copy of the last frame: publishing swapped sb's cells away
+    ScreenBuffer *expected = screen_buffer_create(40, 12);
+    ASSERT(expected != NULL);
+    for (int y = 0; y < 10; y++)
+        for (int x = 0; x < 40; x++)
+            screen_buffer_draw_cell(expected, x, y,
+                                    test_world_cell(x + (frames - 1) / 4, y));
+    screen_buffer_draw_string(expected, 0, 11, "odd");
+
+    // Every frame was either presented or replaced by a newer one, and the
+    // terminal shows the last one
+    long presented, dropped;
+    presenter_stop(p);
+    presenter_get_stats(p, &presented, &dropped);
+    ASSERT(presented >= 1);
+    ASSERT_EQ(presented + dropped, frames);
+
+    VirtualTerm vt;
+    vt_init(&vt, 40, 12);
+    ASSERT(vt_matches(&vt, expected));
+    presenter_destroy(p);
+
+    screen_buffer_free(expected);
+    screen_buffer_free(sb);
+    terminal_restore(&term);
+}
+
+TEST(term_caps_sync_and_scroll) {
+    Terminal term;
+    ASSERT_EQ(terminal_init_headless(&term, TERM_BACKEND_MEMORY, NULL, 40, 12), 0);
+    TermCaps caps = {true, false, false, false};
+    term_set_caps(&caps);
+    term_clear_captured_output();
+
+    ScreenBuffer *sb = screen_buffer_create(40, 12);
+    ASSERT(sb != NULL);
+    ASSERT_EQ(sb->scroll_enabled, 0);
+    screen_buffer_set_scroll_region(sb, 0, 10);
+
+    VirtualTerm vt;
+    vt_init(&vt, 40, 12);
+    for (int f = 0; f < 4; f++) {
+        screen_buffer_set_origin(sb, f, 0);
+        for (int y = 0; y < 10; y++)
+            for (int x = 0; x < 40; x++)
+                screen_buffer_draw_cell(sb, x, y, test_world_cell(x + f, y));
+        screen_buffer_render(sb);
+
+        // Frames are bracketed and never use scroll sequences
+        size_t len = 0;
+        const char *out = term_captured_output(&len);
+        ASSERT(len > 20);
+        ASSERT(memcmp(out, "\x1b[?2026h", 8) == 0);
+        ASSERT(memcmp(out + len - 8, "\x1b[?2026l", 8) == 0);
+        ASSERT(!output_contains(out, len, "P"));
+        ASSERT(vt_matches(&vt, sb));
+    }
+
+    // An unchanged frame sends nothing, not even the brackets
+    screen_buffer_render(sb);
+    size_t len = 0;
+    term_captured_output(&len);
+    ASSERT_EQ(len, 0);
+
+    screen_buffer_free(sb);
+    terminal_restore(&term);
+}
+
+TEST(term_caps_probe_keeps_keys) {
+    Terminal term;
+    ASSERT_EQ(terminal_init_headless(&term, TERM_BACKEND_NULL, NULL, 80, 24), 0);
+
+    // Answers arrive with keys typed in between; only the answers go
+    term_set_input_script("\x1b[?2026;2$yd\x1b[?1uq\x1b[?62;22c\n");
+    terminal_query_caps(&term);
+    ASSERT(term.caps.sync_output);
+    ASSERT(term.caps.kitty_keyboard);
+    char keys[16];
+    ASSERT_EQ(term_take_probe_input(keys, sizeof(keys)), 2);
+    ASSERT(memcmp(keys, "dq", 2) == 0);
+    ASSERT_EQ(term_take_probe_input(keys, sizeof(keys)), 0);
+
+    // No terminal answers: the defaults stand and every byte is a key
+    TermCaps none = {false, false, false, true};
+    term.caps = none;
+    term_set_input_script("\x1b[Aq\n");
+    terminal_query_caps(&term);
+    ASSERT(!term.caps.sync_output);
+    ASSERT(!term.caps.kitty_keyboard);
+
+    // The game takes them as its first input, so the q quits
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 80, 24), 0);
+    ASSERT(input_waiting(&game.input));
+    ASSERT_EQ(game_run_headless(&game, 10), 1);
+    ASSERT(!game.running);
+    game_cleanup(&game);
+}
+
+/*
+ * Game Tests
+ */
+
+TEST(game_headless_run) {
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_MEMORY, NULL, 40, 24), 0);
+
+    // Hold right long enough for the camera to pan, then idle
+    static char script[2 * 100 + 1];
+    for (int i = 0; i < 100; i++) {
+        script[2 * i] = 'd';
+        script[2 * i + 1] = '\n';
+    }
+    term_set_input_script(script);
+    float start_x = game.player.x;
+    ASSERT_EQ(game_run_headless(&game, 120), 120);
+    ASSERT(term_input_script_done());
+    ASSERT(game.player.x > start_x);
+    ASSERT_EQ(game.frames_rendered, 120);
+    ASSERT(game.camera_x > 0);
+
+    size_t len = 0;
+    const char *out = term_captured_output(&len);
+    ASSERT(out != NULL);
+    ASSERT(len > 40 * 24);
+    ASSERT(output_contains(out, len, "Lives: 3"));
+
+    // Replaying the output reproduces the final frame
+    VirtualTerm vt;
+    vt_init(&vt, 40, 24);
+    ASSERT(vt_matches(&vt, game.screen));
+
+    game_cleanup(&game);
+}
+
+TEST(game_fixed_step_interpolation) {
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 40, 24), 0);
+
+    // Each tick records the state it started from
+    game.player.vel_x = 12.0f;
+    float before = game.player.x;
+    game_step(&game);
+    ASSERT_FLOAT_EQ(game.prev_x, before);
+    ASSERT(game.player.x > before);
+
+    // Rendering halfway between ticks draws the player halfway
+    game.prev_x = 10.0f;
+    game.player.x = 12.0f;
+    game.prev_camera_x = game.camera_x = 0.0f;
+    game.prev_camera_y = game.camera_y;
+    game.prev_y = game.player.y;
+    game.render_alpha = 0.5f;
+    game_render(&game);
+    int py = (int)game.player.y - (int)game.camera_y;
+    ASSERT(game.screen->buffer[py * 40 + 11].ch != ' ');
+    ASSERT(game.screen->buffer[py * 40 + 12].ch != game.screen->buffer[py * 40 + 11].ch);
+
+    game_cleanup(&game);
+}
+
+TEST(game_fixed_step_deterministic) {
+    // The same input script always produces the same trajectory
+    float x[2], y[2];
+    for (int run = 0; run < 2; run++) {
+        Game game;
+        ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 40, 24), 0);
+        term_set_input_script("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n"
+                              "\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n"
+                              "d\nd\nd\nd\nd\nd\n");
+        game_run_headless(&game, 90);
+        x[run] = game.player.x;
+        y[run] = game.player.y;
+        game_cleanup(&game);
+    }
+    ASSERT(x[0] == x[1]);
+    ASSERT(y[0] == y[1]);
+}
+
+TEST(game_death_and_restart_roll_back) {
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 40, 24), 0);
+
+    // Three coins on the way to the right
+    const char *text = "WIDTH 40\nHEIGHT 12\nSPAWN 2 9\n\n"
+                       "\n\n\n\n\n\n\n\n\n"
+                       "     ooo\n"
+                       "########################################\n"
+                       "########################################\n";
+    Level level;
+    ASSERT_EQ(level_parse(&level, text, strlen(text), "rollback"), 0);
+    game_set_level(&game, &level);
+    game.tick = GAME_TICK;
+    for (int i = 0; i < 60 && game.level.items.coins_left > 0; i++) {
+        player_move_right(&game.player);
+        game_step(&game);
+    }
+    ASSERT_EQ(game.level.items.coins_collected, 3);
+    ASSERT_EQ(game.player.coins_collected, 3);
+
+    // Dying puts back the coins taken since the level started
+    int lives = game.player.lives;
+    player_kill(&game.player);
+    for (int i = 0; i < 200 && game.player.is_dead; i++)
+        game_step(&game);
+    ASSERT(!game.player.is_dead);
+    ASSERT_EQ(game.player.lives, lives - 1);
+    ASSERT_EQ(game.level.items.coins_collected, 0);
+    ASSERT_EQ(game.player.coins_collected, 0);
+    ASSERT(level_is_coin(&game.level, 5, 9));
+
+    // Restarting undoes the changes and the lost life
+    for (int i = 0; i < 60 && game.level.items.coins_left > 0; i++) {
+        player_move_right(&game.player);
+        game_step(&game);
+    }
+    ASSERT_EQ(game.level.items.coins_left, 0);
+    game_restart(&game);
+    ASSERT_EQ(game.level.edit_count, 0);
+    ASSERT_EQ(game.level.items.coins_left, 3);
+    ASSERT_EQ(game.player.lives, lives);
+    ASSERT_FLOAT_EQ(game.player.x, 2.0f);
+
+    game_cleanup(&game);
+}
+
+TEST(game_swept_collisions) {
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 40, 24), 0);
+
+    // A thin one-way platform, a one-tile wall and a ceiling
+    const char *text = "WIDTH 40\nHEIGHT 40\nSPAWN 5 0\n\n"
+                       "\n\n\n\n\n\n\n\n\n\n"
+                       "          =\n\n\n\n\n\n\n\n\n"
+                       "                           #\n"
+                       "----------------------------\n";
+    level_free(&game.level);
+    ASSERT_EQ(level_parse(&game.level, text, strlen(text), "swept"), 0);
+
+    // At 10 Hz and full fall speed the player moves two tiles per tick
+    // and still lands on the platform row instead of passing through it
+    game.tick = 0.1f;
+    player_init(&game.player, 5.5f, 0.0f);
+    for (int i = 0; i < 30 && !game.player.on_ground; i++)
+        game_step(&game);
+    ASSERT(game.player.on_ground);
+    ASSERT_FLOAT_EQ(game.player.y, 19.0f);
+
+    // Running fast along the platform stops flush against the wall
+    player_init(&game.player, 20.5f, 19.0f);
+    game.player.vel_x = 100.0f;
+    game_step(&game);
+    ASSERT_FLOAT_EQ(game.player.x, 27.0f - PLAYER_HALF_WIDTH);
+    ASSERT_FLOAT_EQ(game.player.vel_x, 0.0f);
+
+    // A fast jump stops under the ceiling
+    player_init(&game.player, 10.5f, 19.0f);
+    game.player.vel_y = -100.0f;
+    game_step(&game);
+    ASSERT_FLOAT_EQ(game.player.y, 11.0f);
+    ASSERT_FLOAT_EQ(game.player.vel_y, 0.0f);
+
+    // Platforms let the player through from below
+    player_init(&game.player, 5.5f, 21.0f);
+    game.player.vel_y = -30.0f;
+    game_step(&game);
+    ASSERT(game.player.y < 20.0f);
+
+    game_cleanup(&game);
+}
+
+TEST(game_physics_tick_rate_independent) {
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 40, 24), 0);
+    const char *text = "WIDTH 80\nHEIGHT 12\nSPAWN 2 9\n\n"
+                       "\n\n\n\n\n\n\n\n\n\n"
+                       "################################################"
+                       "################################\n";
+    level_free(&game.level);
+    ASSERT_EQ(level_parse(&game.level, text, strlen(text), "rates"), 0);
+
+    // Jump apex and sliding distance at 60 Hz and at 10 Hz
+    const float ticks[2] = {1.0f / 60.0f, 0.1f};
+    float apex[2], slide[2];
+    for (int run = 0; run < 2; run++) {
+        game.tick = ticks[run];
+        player_init(&game.player, 5.5f, 9.0f);
+        for (int i = 0; i < 100 && !game.player.on_ground; i++)
+            game_step(&game);
+        ASSERT(game.player.on_ground);
+
+        float ground_y = game.player.y;
+        apex[run] = ground_y;
+        player_jump_press(&game.player);
+        for (int i = 0; i < 300 && !game.player.on_ground; i++) {
+            game_step(&game);
+            if (game.player.y < apex[run])
+                apex[run] = game.player.y;
+        }
+        ASSERT(game.player.on_ground);
+        apex[run] = ground_y - apex[run];
+
+        float start_x = game.player.x;
+        player_move_right(&game.player);
+        for (int i = 0; i < 300 && game.player.vel_x != 0.0f; i++)
+            game_step(&game);
+        ASSERT_FLOAT_EQ(game.player.vel_x, 0.0f);
+        slide[run] = game.player.x - start_x;
+    }
+    ASSERT(apex[0] > 4.0f);
+    ASSERT(fabsf(apex[0] - apex[1]) < 0.05f);
+    ASSERT(slide[0] > 1.0f);
+    ASSERT(fabsf(slide[0] - slide[1]) < 0.05f);
+
+    game_cleanup(&game);
+}
+
+TEST(game_streamed_player_waits_for_ground) {
+    // Ground under a wide streamed level
+    Level level;
+    ASSERT_EQ(level_create(&level, 4096, 24), 0);
+    for (int x = 0; x < level.width; x++)
+        level_set_tile_raw(&level, x, 20, TILE_GROUND);
+    level.spawn_x = 2;
+    level.spawn_y = 19;
+    char path[] = "/tmp/tario_stream_game_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+    ASSERT_EQ(level_save(&level, path), 0);
+    level_free(&level);
+
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 80, 24), 0);
+    ASSERT_EQ(game_load_level(&game, path), 0);
+    unlink(path);
+
+    // Dropped far from anything loaded, the player holds still...
+    ASSERT(!level_tile_loaded(&game.level, 3000, 20));
+    ASSERT(entity_spawn(&game.entities, ENTITY_WALKER, 3.5f, 10.0f) >= 0);
+    ASSERT(entity_spawn(&game.entities, ENTITY_WALKER, 3000.5f, 10.0f) >= 0);
+    ASSERT_EQ(entity_count_active(&game.entities, &game.level), 1);
+    game.entities.count = 0;
+    player_init(&game.player, 3000.5f, 10.0f);
+    game_update(&game, game.tick);
+    ASSERT_FLOAT_EQ(game.player.y, 10.0f);
+
+    // ...until the chunks arrive, then lands on the ground
+    struct timespec pause = {0, 1000000};
+    for (int i = 0; i < 2000 && !game.player.on_ground; i++) {
+        game_update(&game, game.tick);
+        nanosleep(&pause, NULL);
+    }
+    ASSERT(game.player.on_ground);
+    ASSERT(!game.player.is_dead);
+    ASSERT_FLOAT_EQ(game.player.y, 20.0f - PLAYER_HEIGHT);
+
+    game_cleanup(&game);
+}
+
+TEST(game_headless_quit_key) {
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 80, 24), 0);
+
+    term_set_input_script("\n\nq\n");
+    ASSERT_EQ(game_run_headless(&game, 100), 3);
+    ASSERT_EQ(game.running, 0);
+
+    game_cleanup(&game);
+}
+
+TEST(game_headless_has_no_input_fd) {
+    // Headless runs read the script instead of polling stdin
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 80, 24), 0);
+    ASSERT_EQ(term_input_fd(), -1);
+    game_cleanup(&game);
+}
+
+TEST(game_pace_idle_states) {
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 80, 24), 0);
+
+    // The player spawns in the air, lands and comes to rest
+    ASSERT_EQ(game_pace(&game), GAME_ACTIVE);
+    game_run_headless(&game, 120);
+    ASSERT_EQ(game_pace(&game), GAME_RESTING);
+
+    // Moving wakes the loop back up to the full rate
+    term_set_input_script("d\n");
+    game_run_headless(&game, 1);
+    ASSERT_EQ(game_pace(&game), GAME_ACTIVE);
+
+    // Paused is idle no matter what the player is doing
+    term_set_input_script("p\n");
+    game_run_headless(&game, 1);
+    ASSERT(game.paused);
+    ASSERT_EQ(game_pace(&game), GAME_IDLE);
+
+    // Except while an ESC waits to be told apart from a sequence
+    KeyEvent ev;
+    input_feed(&game.input, "\x1b", 1);
+    ASSERT(!input_next(&game.input, &ev));
+    ASSERT_EQ(game_pace(&game), GAME_ACTIVE);
+    input_feed(&game.input, "[A", 2);
+    ASSERT(input_next(&game.input, &ev));
+    ASSERT_EQ(ev.key, KEY_UP);
+    ASSERT_EQ(game_pace(&game), GAME_IDLE);
+
+    // Victory only idles once the player has stopped
+    term_set_input_script("p\n");
+    game_run_headless(&game, 120);
+    game.victory = true;
+    ASSERT_EQ(game_pace(&game), GAME_IDLE);
+    game.player.vel_x = 5.0f;
+    ASSERT_EQ(game_pace(&game), GAME_ACTIVE);
+
+    game_cleanup(&game);
+}
+
+/*
+ * Input Tests
+ */
+
+// Feed a string to the parser and take the next event
+static bool feed_next(InputParser *p, const char *data, KeyEvent *ev) {
+    input_feed(p, data, (int)strlen(data));
+    return input_next(p, ev);
+}
+
+TEST(input_split_sequences) {
+    InputParser p;
+    KeyEvent ev;
+    input_init(&p);
+
+    ASSERT(feed_next(&p, "a", &ev));
+    ASSERT_EQ(ev.key, 'a');
+    ASSERT_EQ(ev.action, KEY_PRESS);
+
+    // A cursor key split across reads
+    ASSERT(!feed_next(&p, "\x1b", &ev));
+    ASSERT(!feed_next(&p, "[", &ev));
+    ASSERT(input_waiting(&p));
+    ASSERT(feed_next(&p, "C", &ev));
+    ASSERT_EQ(ev.key, KEY_RIGHT);
+    ASSERT(!input_waiting(&p));
+
+    // Application mode cursor keys and modifiers
+    ASSERT(feed_next(&p, "\x1bOA", &ev));
+    ASSERT_EQ(ev.key, KEY_UP);
+    ASSERT(feed_next(&p, "\x1b[1;5D", &ev));
+    ASSERT_EQ(ev.key, KEY_LEFT);
+    ASSERT_EQ(ev.mods, KEY_MOD_CTRL);
+
+    // Capability query replies are not keys
+    ASSERT(!feed_next(&p, "\x1b[?2026;2$y\x1b[?1u\x1b[?62;22c", &ev));
+    ASSERT(!input_waiting(&p));
+
+    // A lone ESC is the Escape key once its timeout passes
+    ASSERT(!feed_next(&p, "\x1b", &ev));
+    p.esc_ns -= INPUT_ESC_TIMEOUT_NS;
+    ASSERT(input_next(&p, &ev));
+    ASSERT_EQ(ev.key, KEY_ESCAPE);
+}
+
+TEST(input_kitty_events) {
+    InputParser p;
+    KeyEvent ev;
+    input_init(&p);
+
+    ASSERT(feed_next(&p, "\x1b[97u", &ev));
+    ASSERT_EQ(ev.key, 'a');
+    ASSERT_EQ(ev.action, KEY_PRESS);
+    ASSERT(feed_next(&p, "\x1b[97;1:2u", &ev));
+    ASSERT_EQ(ev.action, KEY_REPEAT);
+    ASSERT(feed_next(&p, "\x1b[97;1:3u", &ev));
+    ASSERT_EQ(ev.key, 'a');
+    ASSERT_EQ(ev.action, KEY_RELEASE);
+
+    ASSERT(feed_next(&p, "\x1b[1;1:3A", &ev));
+    ASSERT_EQ(ev.key, KEY_UP);
+    ASSERT_EQ(ev.action, KEY_RELEASE);
+
+    ASSERT(feed_next(&p, "\x1b[113;5u", &ev));
+    ASSERT_EQ(ev.key, 'q');
+    ASSERT_EQ(ev.mods, KEY_MOD_CTRL);
+
+    // Escape has its own code, so there is no timeout to wait for
+    ASSERT(feed_next(&p, "\x1b[27u", &ev));
+    ASSERT_EQ(ev.key, KEY_ESCAPE);
+}
+
+TEST(input_ring_wraps) {
+    InputParser p;
+    KeyEvent ev;
+    input_init(&p);
+
+    // Three passes of 200 bytes walk the indices around the ring
+    char keys[200];
+    memset(keys, 'x', sizeof(keys));
+    for (int pass = 0; pass < 3; pass++) {
+        ASSERT_EQ(input_feed(&p, keys, sizeof(keys)), 200);
+        int events = 0;
+        while (input_next(&p, &ev)) {
+            ASSERT_EQ(ev.key, 'x');
+            events++;
+        }
+        ASSERT_EQ(events, 200);
+    }
+
+    // A full ring takes no more
+    char full[INPUT_RING_SIZE + 10];
+    memset(full, 'y', sizeof(full));
+    ASSERT_EQ(input_feed(&p, full, sizeof(full)), INPUT_RING_SIZE);
+}
+
+TEST(game_key_release_input) {
+    Game game;
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 80, 24), 0);
+
+    // Arrow keys move instead of quitting; a lone ESC still quits
+    term_set_input_script("\x1b[C\n\n\x1b\n\n");
+    ASSERT_EQ(game_run_headless(&game, 10), 3);
+    ASSERT(!game.running);
+    game_cleanup(&game);
+
+    // With release events a held key keeps moving until released
+    ASSERT_EQ(game_init_headless(&game, TERM_BACKEND_NULL, NULL, 80, 24), 0);
+    game.key_releases = true;
+    term_set_input_script("\x1b[100u\n\n\n\n\n\n\n\n\n\n\x1b[100;1:3u\n");
+    game_run_headless(&game, 10);
+    ASSERT(game.held_right);
+    ASSERT(game.player.vel_x > 0.0f);
+    game_run_headless(&game, 1);
+    ASSERT(!game.held_right);
+
+    // Releasing jump early cuts the jump short
+    game.player.vel_y = -10.0f;
+    term_set_input_script("\x1b[32;1:3u\n");
+    game_handle_input(&game);
+    ASSERT(game.player.vel_y > -10.0f);
+    game_cleanup(&game);
+}
+
+/*
+ * Profiler Tests
+ */
+
+TEST(profile_histogram_percentiles) {
+    profile_reset();
+
+    // 98% of frames at 1 ms, a 2% tail at 20 ms
+    for (int i = 0; i < 980; i++) {
+        profile_record(PROF_UPDATE, 0, 1000000);
+    }
+    for (int i = 0; i < 20; i++) {
+        profile_record(PROF_UPDATE, 0, 20000000);
+    }
+
+    ProfStats stats;
+    profile_get_stats(PROF_UPDATE, &stats);
+    ASSERT_EQ(stats.count, 1000);
+    ASSERT(fabs(stats.mean_ms - 1.38) < 0.001);
+    ASSERT(fabs(stats.p50_ms - 1.0) < 0.125);
+    ASSERT(fabs(stats.p99_ms - 20.0) < 2.5);
+    ASSERT(fabs(stats.max_ms - 20.0) < 0.001);
+
+    // Untouched phases report zeros
+    profile_get_stats(PROF_COLLISIONS, &stats);
+    ASSERT_EQ(stats.count, 0);
+    ASSERT(stats.p99_ms == 0.0);
+
+    profile_reset();
+}
+
+TEST(profile_trace_json) {
+    char path[] = "/tmp/tario_trace_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+
+    profile_reset();
+    ASSERT_EQ(profile_trace_start(), 0);
+    uint64_t now = profile_now_ns();
+    profile_record(PROF_UPDATE, now, now + 2000);
+    profile_record(PROF_PRESENT, now + 2000, now + 5000);
+    ASSERT_EQ(profile_trace_write(path), 0);
+
+    char json[1024];
+    FILE *fp = fopen(path, "r");
+    ASSERT(fp != NULL);
+    size_t len = fread(json, 1, sizeof(json) - 1, fp);
+    json[len] = '\0';
+    fclose(fp);
+    unlink(path);
+
+    ASSERT(strncmp(json, "{\"traceEvents\":[", 16) == 0);
+    ASSERT(strstr(json, "\"name\":\"update\"") != NULL);
+    ASSERT(strstr(json, "\"dur\":2.000") != NULL);
+    ASSERT(strstr(json, "\"name\":\"present\"") != NULL);
+    ASSERT(strstr(json, "\"tid\":2") != NULL);
+    ASSERT(strstr(json, "},\n{") != NULL);
+    ASSERT(strstr(json, "},\n]") == NULL);
+
+    // Tracing stops once written
+    ASSERT_EQ(profile_trace_write(path), -1);
+    profile_reset();
+}
+
 /*
  * Main test runner
  */
@@ -260,12 +2073,68 @@ int main(void) {
     RUN_TEST(level_coin_collection);
     RUN_TEST(level_deadly_tiles);
     RUN_TEST(level_goal_exists);
+    RUN_TEST(level_load_matches_builtin);
+    RUN_TEST(level_parse_validation);
+    RUN_TEST(level_parse_large);
+    RUN_TEST(level_binary_round_trip);
+    RUN_TEST(level_binary_edge_chunks);
+    RUN_TEST(level_sparse_chunks);
+    RUN_TEST(level_tile_flags_and_query);
+    RUN_TEST(level_row_layers);
+    RUN_TEST(level_streaming);
+    RUN_TEST(level_generate);
+    RUN_TEST(level_collectible_index);
+    RUN_TEST(level_edit_journal);
+    printf("\n");
+
+    // Entity tests
+    printf("Entity Tests:\n");
+    RUN_TEST(entity_walkers_turn);
+    RUN_TEST(entity_jumpers_and_removal);
+    RUN_TEST(entity_batch_update);
     printf("\n");
 
     // Render tests
     printf("Render Tests:\n");
     RUN_TEST(screen_buffer_create);
     RUN_TEST(screen_buffer_bounds);
+    RUN_TEST(screen_buffer_diff_render);
+    RUN_TEST(screen_buffer_single_write_per_frame);
+    RUN_TEST(screen_buffer_sgr_coalescing);
+    RUN_TEST(term_output_pending_without_tty);
+    RUN_TEST(screen_buffer_blit_row);
+    RUN_TEST(screen_buffer_camera_scroll);
+    RUN_TEST(presenter_output_thread);
+    RUN_TEST(term_caps_sync_and_scroll);
+    RUN_TEST(term_caps_probe_keeps_keys);
+    printf("\n");
+
+    // Game tests
+    printf("Game Tests:\n");
+    RUN_TEST(game_headless_run);
+    RUN_TEST(game_fixed_step_interpolation);
+    RUN_TEST(game_fixed_step_deterministic);
+    RUN_TEST(game_swept_collisions);
+    RUN_TEST(game_physics_tick_rate_independent);
+    RUN_TEST(game_death_and_restart_roll_back);
+    RUN_TEST(game_streamed_player_waits_for_ground);
+    RUN_TEST(game_headless_quit_key);
+    RUN_TEST(game_headless_has_no_input_fd);
+    RUN_TEST(game_key_release_input);
+    RUN_TEST(game_pace_idle_states);
+    printf("\n");
+
+    // Input tests
+    printf("Input Tests:\n");
+    RUN_TEST(input_split_sequences);
+    RUN_TEST(input_kitty_events);
+    RUN_TEST(input_ring_wraps);
+    printf("\n");
+
+    // Profiler tests
+    printf("Profiler Tests:\n");
+    RUN_TEST(profile_histogram_percentiles);
+    RUN_TEST(profile_trace_json);
     printf("\n");
 
     printf("=================================\n");
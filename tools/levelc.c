@@ -0,0 +1,90 @@
+/*
+ * tario-levelc: convert a text level to the binary level format, or
+ * generate a level from a seed
+ *
+ * Usage: tario-levelc INPUT.tario OUTPUT.tlv
+ *        tario-levelc --generate WIDTHxHEIGHT [--seed N] [--density D]
+ *                     OUTPUT.tlv
+ */
+
+#include "level.h"
+#include "levelgen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static void print_usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s INPUT.tario OUTPUT.tlv\n"
+          "       %s --generate WIDTHxHEIGHT [--seed N] [--density D] "
+          "OUTPUT.tlv\n",
+          prog, prog);
+}
+
+// Parse the generator options; returns the output path or NULL
+static const char *parse_generate(int argc, char **argv,
+                                  LevelGenParams *params) {
+  const char *out = NULL;
+  levelgen_defaults(params);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+      if (sscanf(argv[++i], "%dx%d", &params->width, &params->height) != 2)
+        return NULL;
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      params->seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc) {
+      params->density = strtof(argv[++i], NULL);
+    } else if (!out && argv[i][0] != '-') {
+      out = argv[i];
+    } else {
+      return NULL;
+    }
+  }
+  return out;
+}
+
+int main(int argc, char **argv) {
+  Level level;
+  const char *in = NULL;
+  const char *out = NULL;
+
+  if (argc > 1 && strcmp(argv[1], "--generate") == 0) {
+    LevelGenParams params;
+    out = parse_generate(argc, argv, &params);
+    if (!out) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    if (level_generate(&level, &params) != 0) {
+      fprintf(stderr, "%s: cannot generate a %dx%d level (at least %dx%d)\n",
+              out, params.width, params.height, LEVELGEN_MIN_WIDTH,
+              LEVELGEN_MIN_HEIGHT);
+      return 1;
+    }
+  } else if (argc == 3) {
+    in = argv[1];
+    out = argv[2];
+    if (level_load(&level, in) != 0)
+      return 1;
+  } else {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  int result = level_save(&level, out);
+  if (result == 0) {
+    struct stat in_st, out_st;
+    if (!in && stat(out, &out_st) == 0) {
+      printf("%s: %dx%d level, %lld bytes\n", out, level.width,
+             level.height, (long long)out_st.st_size);
+    } else if (in && stat(in, &in_st) == 0 && stat(out, &out_st) == 0) {
+      printf("%s: %dx%d level, %lld bytes -> %lld bytes\n", out,
+             level.width, level.height, (long long)in_st.st_size,
+             (long long)out_st.st_size);
+    }
+  }
+
+  level_free(&level);
+  return result == 0 ? 0 : 1;
+}